@@ -1,3 +1,27 @@
 // WiFi settings
 const char* ssid = "";
 const char* password = "";
+
+// Location for sunrise/sunset scheduling (degrees, north and east positive)
+const float latitude = 59.33;
+const float longitude = 18.07;
+
+// Limit switches on GPIO32 (top) and GPIO33 (bottom) - without them every move
+// runs the configured travel open loop
+const bool endstops_enabled = false;
+
+// Photoresistor divider on GPIO34 - only enable when one is fitted, a floating
+// pin reads as random light levels and moves the blinds during the day
+const bool light_sensor_enabled = false;
+
+// MQTT settings (leave mqtt_server empty to disable)
+const char* mqtt_server = "";
+const int mqtt_port = 1883;
+const char* mqtt_user = "";
+const char* mqtt_password = "";
+
+// OTA update server (leave empty to disable), e.g. "http://192.168.1.10:8000"
+const char* ota_server = "";
+
+// PEM public key matching the key the update server signs images with
+const char* ota_public_key = "";
\ No newline at end of file
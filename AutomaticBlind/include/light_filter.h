@@ -0,0 +1,48 @@
+#ifndef LIGHT_FILTER_H
+#define LIGHT_FILTER_H
+
+#include <stdint.h>
+
+// Ambient light filtering and blind position decisions
+
+// Filter settings
+const int LIGHT_MEDIAN_TAPS = 5;   // Spike rejection window, in updates
+const int LIGHT_BAND_COUNT = 3;    // Dim, bright, direct sun
+
+struct LightConfig {
+    uint8_t emaShift;                              // EMA weight is 1 / 2^emaShift
+    uint16_t thresholds[LIGHT_BAND_COUNT - 1];     // Band edges in ADC counts (0-4095), ascending
+    uint16_t hysteresis;                           // Counts past an edge before switching band
+    uint8_t positions[LIGHT_BAND_COUNT];           // Blind position per band, 0 (up) to 100 (down)
+    uint32_t holdTime;                             // ms a new band must persist before it is used
+};
+
+// Defaults used by the firmware
+const LightConfig DEFAULT_LIGHT_CONFIG = {
+    3,
+    {2000, 3200},
+    150,
+    {0, 50, 80},
+    600000 // 10 minutes
+};
+
+struct LightFilter {
+    uint16_t window[LIGHT_MEDIAN_TAPS];
+    uint8_t count;
+    uint8_t next;
+    int32_t ema; // Q8 fixed point
+};
+
+struct LightDecision {
+    int band;           // Band currently driving the blind, -1 before the first update
+    int pendingBand;    // Band the level moved into, waiting out the hold time
+    uint32_t pendingSince;
+};
+
+// Function declarations
+void lightFilterReset(LightFilter& filter);
+uint16_t lightFilterUpdate(LightFilter& filter, const LightConfig& config, uint16_t sample);
+void lightDecisionReset(LightDecision& decision);
+int lightDecisionUpdate(LightDecision& decision, const LightConfig& config, uint16_t level, uint32_t now);
+
+#endif
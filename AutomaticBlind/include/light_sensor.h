@@ -0,0 +1,20 @@
+#ifndef LIGHT_SENSOR_H
+#define LIGHT_SENSOR_H
+
+#include <Arduino.h>
+
+#include "light_filter.h"
+
+// Light sensor settings - photoresistor divider on GPIO34 (ADC1 channel 6)
+const int LIGHT_SAMPLE_RATE = 20000;       // I2S ADC sample rate in Hz
+const int LIGHT_BLOCK_SAMPLES = 256;       // Samples per DMA buffer
+const int LIGHT_BLOCKS_PER_UPDATE = 4;     // ~50 ms averaged, cancels lamp flicker
+const int LIGHT_UPDATE_INTERVAL = 2000;    // ms between filter updates
+
+// Function declarations
+bool initializeLightSensor(bool enabled);
+bool isLightSensorActive();
+uint16_t getLightLevel();
+int getLightTargetPosition();
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+// Motion directions reported to the progress callback
+#define MOTION_IDLE 0
+#define MOTION_UP 1
+#define MOTION_DOWN 2
+
+// Called when a move starts, when the travelled percentage changes and when
+// the move ends. Position is 0 (fully up) to 100 (fully down). Runs between
+// step pulses, so it must return quickly and never touch the network.
+typedef void (*MotionProgressCallback)(int direction, int position);
+
+#endif
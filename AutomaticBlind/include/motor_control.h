@@ -4,24 +4,67 @@
 #include <Arduino.h>
 #include <EEPROM.h>
 
+#include "motion.h"
+
 // Motor pin definitions
 const int PUL = 25;
 const int DIR = 26;
 const int ENA = 27;
 
-// Motor settings
+// Limit switch pins (normally open, switching to GND)
+const int TOP_SWITCH_PIN = 32;
+const int BOTTOM_SWITCH_PIN = 33;
+
+// Motor settings - travel and delay are defaults until calibrated
 const int steps_per_rev = 6400;
 const double rotations = 31;   
 const int step_delay = 50;
 
+// Motion profile settings
+const int PROFILE_START_DELAY = 200;   // Step delay (us) at the start and end of a move
+const int PROFILE_RAMP_STEPS = 3200;   // Steps to accelerate from / brake to the start delay
+const int ENDSTOP_OVERTRAVEL = 5;      // % of travel to keep going when heading for an endstop
+
+// Calibration settings
+const int CALIBRATION_STEP_DELAY = 100;                            // Slow, safe speed for homing
+const int CALIBRATION_DELAYS[] = {80, 65, 50, 40, 32, 26, 20};     // Speeds to try, slowest first
+const int CALIBRATION_TOLERANCE = 200;                             // Steps a run may be off by
+const int STEP_DELAY_MARGIN = 25;                                  // % slower than the fastest reliable speed
+
 // EEPROM settings
 #define EEPROM_ADDR 0
+#define EEPROM_POSITION_ADDR (EEPROM_ADDR + sizeof(int))
+#define EEPROM_CALIBRATION_ADDR (EEPROM_POSITION_ADDR + sizeof(int))
+#define EEPROM_FAULT_ADDR (EEPROM_CALIBRATION_ADDR + sizeof(MotorCalibration))
+#define EEPROM_SIZE (EEPROM_FAULT_ADDR + sizeof(uint32_t))
+#define CALIBRATION_MAGIC 0x424C4E44 // "BLND"
+#define HOMING_FAULT_MAGIC 0x484F4D45 // "HOME" - anything else means no fault
+
+// Measured travel and step delays per direction
+struct MotorCalibration {
+    uint32_t magic;
+    int32_t travelSteps;
+    int32_t upStepDelay;
+    int32_t downStepDelay;
+};
 
 // Function declarations
-void initializeMotorPins();
+void initializeMotorPins(bool enabled);
 void initializeEEPROM();
 void moveBlindsDown();
 void moveBlindsUp();
+void moveBlindsToPosition(int position);
+bool homeBlinds();
+bool calibrateBlinds();
 int getCurrentBlindsState();
+int getCurrentBlindsPosition();
+const MotorCalibration& getMotorCalibration();
+bool isMotorCalibrated();
+bool areEndstopsEnabled();
+bool isHomingFaulted();
+void setMotionProgressCallback(MotionProgressCallback callback);
+bool isMotorBusy();
+bool tryHoldMotorIdle();
+void releaseMotorIdle();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include <Arduino.h>
+
+#include "mqtt_outbox.h"
+
+// MQTT settings
+const int MQTT_RECONNECT_INTERVAL = 5000; // 5 seconds
+const int MQTT_TASK_INTERVAL = 50;        // ms between polls of the client task
+const int MQTT_BUFFER_SIZE = 768;         // Large enough for the discovery payload
+#define MQTT_BASE_TOPIC "smartblinds"
+#define MQTT_DISCOVERY_PREFIX "homeassistant"
+
+// Commands received on the command topic
+#define MQTT_CMD_NONE 0
+#define MQTT_CMD_OPEN 1
+#define MQTT_CMD_CLOSE 2
+
+// Function declarations
+void initializeMQTT(const char* server, int port, const char* user, const char* password);
+void recordBlindsMotion(int direction, int position);
+int takeMQTTCommand();
+bool isMQTTEnabled();
+bool isMQTTConnected();
+
+#endif
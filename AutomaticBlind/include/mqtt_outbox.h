@@ -0,0 +1,36 @@
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+// Change-only state publishing and the offline message queue
+
+// Outbox settings
+const int MQTT_QUEUE_SIZE = 8;   // Messages buffered while offline
+
+struct MQTTMessage {
+    char topic[64];
+    char payload[16];
+};
+
+// Retained messages waiting for the broker, oldest first, plus the last values
+// handed out so only changes are queued
+struct MQTTOutbox {
+    MQTTMessage messages[MQTT_QUEUE_SIZE];
+    int count;
+    char lastState[12];
+    int lastPosition;
+    int lastFault;   // -1 until the first report
+};
+
+// Sends one retained message, returns false if it could not be sent
+typedef bool (*MQTTPublishFunction)(const char* topic, const char* payload);
+
+// Function declarations
+void outboxReset(MQTTOutbox& outbox);
+bool outboxEnqueue(MQTTOutbox& outbox, const char* topic, const char* payload);
+bool outboxRecordMotion(MQTTOutbox& outbox, const char* stateTopic, const char* positionTopic,
+                        int direction, int position);
+bool outboxRecordFault(MQTTOutbox& outbox, const char* faultTopic, bool faulted);
+int outboxFlush(MQTTOutbox& outbox, MQTTPublishFunction publish);
+const char* motionStateName(int direction, int position);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <Arduino.h>
+
+// OTA settings
+const int OTA_CHUNK_SIZE = 4096;         // Bytes read from the network per chunk
+const int OTA_HTTP_TIMEOUT = 10000;      // ms without data before giving up
+const int OTA_MAX_SIGNATURE_SIZE = 80;   // DER encoded ECDSA P-256 signature
+const int OTA_MOTOR_POLL_INTERVAL = 20;  // ms between checks while the motor runs
+#define OTA_IMAGE_PATH "/firmware.bin"
+#define OTA_COMPRESSED_IMAGE_PATH "/firmware.bin.zlib"
+#define OTA_SIGNATURE_PATH "/firmware.sig"
+#define OTA_REPORT_PATH "/report"
+
+// Function declarations
+void initializeOTA(const char* serverUrl, const char* publicKey);
+bool startOTAUpdate(bool compressed);
+bool isOTARestartPending();
+String getOTAStatus();
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SOLAR_SCHEDULE_H
+#define SOLAR_SCHEDULE_H
+
+#include <stdint.h>
+
+// Sunrise/sunset times for schedule rules
+
+// Solar events
+#define SOLAR_CIVIL_DAWN 0
+#define SOLAR_SUNRISE 1
+#define SOLAR_SUNSET 2
+#define SOLAR_CIVIL_DUSK 3
+
+// Event times in minutes after UTC midnight of the given date. When the sun
+// doesn't cross the event altitude, rising and setting events both land on
+// solar midnight (sun stays above) or solar noon (sun stays below).
+struct SolarDay {
+    int16_t events[4];
+};
+
+// A schedule time relative to a solar event
+struct SolarRule {
+    int event;
+    int offset;    // Minutes after the event, negative for before
+    int earliest;  // Local minutes after midnight, clamps the result
+    int latest;
+};
+
+// Function declarations
+void computeSolarDay(int year, int month, int day, float latitude, float longitude, SolarDay& result);
+int applySolarRule(const SolarDay& day, const SolarRule& rule, int utcOffsetMinutes);
+
+#endif
@@ -0,0 +1,80 @@
+#include "light_filter.h"
+
+void lightFilterReset(LightFilter& filter) {
+    filter.count = 0;
+    filter.next = 0;
+    filter.ema = 0;
+}
+
+// Median of the last few samples drops short spikes (reflections, passing
+// shadows), then an integer EMA smooths what is left
+uint16_t lightFilterUpdate(LightFilter& filter, const LightConfig& config, uint16_t sample) {
+    filter.window[filter.next] = sample;
+    filter.next = (filter.next + 1) % LIGHT_MEDIAN_TAPS;
+    if (filter.count < LIGHT_MEDIAN_TAPS) {
+        filter.count++;
+    }
+
+    // Insertion sort on a copy - the window is tiny
+    uint16_t sorted[LIGHT_MEDIAN_TAPS];
+    for (int i = 0; i < filter.count; i++) {
+        uint16_t value = filter.window[i];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    int32_t median = (int32_t)sorted[filter.count / 2] << 8;
+
+    // Start the EMA at the first value instead of ramping up from zero
+    if (filter.count == 1) {
+        filter.ema = median;
+    } else {
+        filter.ema += (median - filter.ema) >> config.emaShift;
+    }
+
+    return (uint16_t)((filter.ema + 128) >> 8);
+}
+
+void lightDecisionReset(LightDecision& decision) {
+    decision.band = -1;
+    decision.pendingBand = -1;
+    decision.pendingSince = 0;
+}
+
+// Returns the blind position for the current light level. Band edges need to be
+// crossed by the hysteresis margin and the new band has to last for the hold
+// time, so clouds passing by don't move the blind back and forth.
+int lightDecisionUpdate(LightDecision& decision, const LightConfig& config, uint16_t level, uint32_t now) {
+    if (decision.band < 0) {
+        int band = 0;
+        while (band < LIGHT_BAND_COUNT - 1 && level >= config.thresholds[band]) {
+            band++;
+        }
+        decision.band = band;
+        decision.pendingBand = band;
+        decision.pendingSince = now;
+        return config.positions[band];
+    }
+
+    int band = decision.band;
+    while (band < LIGHT_BAND_COUNT - 1 && level >= config.thresholds[band] + config.hysteresis) {
+        band++;
+    }
+    while (band > 0 && level + config.hysteresis <= config.thresholds[band - 1]) {
+        band--;
+    }
+
+    if (band != decision.pendingBand) {
+        decision.pendingBand = band;
+        decision.pendingSince = now;
+    }
+
+    if (decision.pendingBand != decision.band && now - decision.pendingSince >= config.holdTime) {
+        decision.band = decision.pendingBand;
+    }
+
+    return config.positions[decision.band];
+}
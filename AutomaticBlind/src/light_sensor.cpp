@@ -0,0 +1,111 @@
+#include <driver/i2s.h>
+#include <driver/adc.h>
+
+#include "light_sensor.h"
+
+#define LIGHT_I2S_PORT I2S_NUM_0
+#define LIGHT_ADC_CHANNEL ADC1_CHANNEL_6 // GPIO34
+
+static bool lightSensorActive = false;
+
+// Written by the sampling task, read by the main loop (32-bit, so no locking)
+static volatile uint32_t lightLevel = 0;
+static volatile int32_t lightTargetPosition = 0;
+
+static LightFilter lightFilter;
+static LightDecision lightDecision;
+
+// Sample a burst through DMA and return the average, in ADC counts
+static uint16_t readLightBurst() {
+    static uint16_t samples[LIGHT_BLOCK_SAMPLES];
+    uint32_t sum = 0;
+    uint32_t count = 0;
+
+    i2s_adc_enable(LIGHT_I2S_PORT);
+    i2s_zero_dma_buffer(LIGHT_I2S_PORT);
+
+    // The first buffer may still hold data from before the ADC was paused
+    for (int block = 0; block <= LIGHT_BLOCKS_PER_UPDATE; block++) {
+        size_t bytesRead = 0;
+        i2s_read(LIGHT_I2S_PORT, samples, sizeof(samples), &bytesRead, portMAX_DELAY);
+        if (block == 0) continue;
+
+        size_t sampleCount = bytesRead / sizeof(uint16_t);
+        for (size_t i = 0; i < sampleCount; i++) {
+            sum += samples[i] & 0x0FFF; // Upper 4 bits carry the channel number
+        }
+        count += sampleCount;
+    }
+
+    i2s_adc_disable(LIGHT_I2S_PORT);
+
+    return count > 0 ? sum / count : 0;
+}
+
+// Runs on core 0, away from the web server and motor loop. CPU cost is one
+// short burst per update interval regardless of the sample rate.
+static void lightSensorTask(void* parameter) {
+    TickType_t lastWake = xTaskGetTickCount();
+
+    for (;;) {
+        uint16_t raw = readLightBurst();
+        uint16_t level = lightFilterUpdate(lightFilter, DEFAULT_LIGHT_CONFIG, raw);
+        lightLevel = level;
+        lightTargetPosition = lightDecisionUpdate(lightDecision, DEFAULT_LIGHT_CONFIG, level, millis());
+
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(LIGHT_UPDATE_INTERVAL));
+    }
+}
+
+bool initializeLightSensor(bool enabled) {
+    if (!enabled) {
+        Serial.println("Light sensor disabled");
+        return false;
+    }
+
+    i2s_config_t i2sConfig = {};
+    i2sConfig.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+    i2sConfig.sample_rate = LIGHT_SAMPLE_RATE;
+    i2sConfig.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    i2sConfig.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+    i2sConfig.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+    i2sConfig.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+    i2sConfig.dma_buf_count = 2;
+    i2sConfig.dma_buf_len = LIGHT_BLOCK_SAMPLES;
+    i2sConfig.use_apll = false;
+
+    if (i2s_driver_install(LIGHT_I2S_PORT, &i2sConfig, 0, NULL) != ESP_OK) {
+        Serial.println("Light sensor: I2S driver install failed");
+        return false;
+    }
+
+    adc1_config_width(ADC_WIDTH_BIT_12);
+    adc1_config_channel_atten(LIGHT_ADC_CHANNEL, ADC_ATTEN_DB_11);
+    i2s_set_adc_mode(ADC_UNIT_1, LIGHT_ADC_CHANNEL);
+    i2s_adc_disable(LIGHT_I2S_PORT);
+
+    lightFilterReset(lightFilter);
+    lightDecisionReset(lightDecision);
+
+    if (xTaskCreatePinnedToCore(lightSensorTask, "light", 3072, NULL, 1, NULL, 0) != pdPASS) {
+        Serial.println("Light sensor: failed to start sampling task");
+        i2s_driver_uninstall(LIGHT_I2S_PORT);
+        return false;
+    }
+
+    lightSensorActive = true;
+    Serial.println("Light sensor started");
+    return true;
+}
+
+bool isLightSensorActive() {
+    return lightSensorActive;
+}
+
+uint16_t getLightLevel() {
+    return lightLevel;
+}
+
+int getLightTargetPosition() {
+    return lightTargetPosition;
+}
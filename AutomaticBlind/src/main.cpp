@@ -6,6 +6,10 @@
 
 #include "config.h"
 #include "motor_control.h"
+#include "mqtt_client.h"
+#include "light_sensor.h"
+#include "solar_schedule.h"
+#include "ota_update.h"
 
 // webserver on port 8080
 WebServer server(8080);
@@ -36,6 +40,15 @@ unsigned long lastResetTime = 0;
 // Day skip configuration
 bool skipDays[7] = {false, false, false, false, false, false, false}; // Sun, Mon, Tue, Wed, Thu, Fri, Sat
 
+// Schedule rules: solar event, offset in minutes, earliest and latest local time
+const SolarRule WEEKDAY_UP_RULE = {SOLAR_SUNRISE, 0, 6 * 60, 12 * 60};     // Sunrise, not before 6:00
+const SolarRule WEEKEND_UP_RULE = {SOLAR_SUNRISE, 0, 9 * 60, 12 * 60};     // Sunrise, not before 9:00
+const SolarRule DOWN_RULE = {SOLAR_CIVIL_DUSK, 0, 15 * 60, 22 * 60};       // Civil dusk, not after 22:00
+
+// Sun times for the current day, recalculated when the date changes
+SolarDay solarToday;
+int solarDayOfYear = -1;
+
 // Stability improvements
 unsigned long lastHeapCheck = 0;
 unsigned long wifiReconnectTimer = 0;
@@ -177,6 +190,34 @@ bool isWeekend(int dayOfWeek) {
     return (dayOfWeek == 0 || dayOfWeek == 6); // Sunday or Saturday
 }
 
+// Recalculate sun times once per day instead of on every scheduler tick
+void updateSolarSchedule(struct tm *currentTime) {
+    if (currentTime->tm_yday == solarDayOfYear) return;
+    
+    computeSolarDay(currentTime->tm_year + 1900, currentTime->tm_mon + 1, currentTime->tm_mday,
+                    latitude, longitude, solarToday);
+    solarDayOfYear = currentTime->tm_yday;
+    
+    Serial.printf("Solar times (UTC minutes): dawn %d, sunrise %d, sunset %d, dusk %d\n",
+                  solarToday.events[SOLAR_CIVIL_DAWN], solarToday.events[SOLAR_SUNRISE],
+                  solarToday.events[SOLAR_SUNSET], solarToday.events[SOLAR_CIVIL_DUSK]);
+}
+
+// Scheduled times in local minutes after midnight
+int getScheduledUpTime(int dayOfWeek, int utcOffsetMinutes) {
+    return applySolarRule(solarToday, isWeekday(dayOfWeek) ? WEEKDAY_UP_RULE : WEEKEND_UP_RULE, utcOffsetMinutes);
+}
+
+int getScheduledDownTime(int utcOffsetMinutes) {
+    return applySolarRule(solarToday, DOWN_RULE, utcOffsetMinutes);
+}
+
+String formatMinutes(int minutes) {
+    char buffer[8];
+    sprintf(buffer, "%02d:%02d", minutes / 60, minutes % 60);
+    return String(buffer);
+}
+
 // Get day name
 String getDayName(int dayOfWeek) {
     const char* days[] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
@@ -195,15 +236,20 @@ String getShortDayName(int dayOfWeek) {
     return "???";
 }
 
-// Memory-efficient HTML generation - split into smaller functions
-String generateHTMLHeader() {
-    return R"rawliteral(<!DOCTYPE html>
+// Memory-efficient HTML generation - split into smaller functions.
+// Only the status page refreshes itself - reloading an action page would
+// repeat the action.
+String generateHTMLHeader(bool autoRefresh = false) {
+    String html = R"rawliteral(<!DOCTYPE html>
 <html>
 <head>
     <title>Smart Blinds</title>
     <meta name="viewport" content="width=device-width, initial-scale=1">
-    <meta http-equiv="refresh" content="30">
-    <style>
+)rawliteral";
+    if (autoRefresh) {
+        html += "    <meta http-equiv=\"refresh\" content=\"30\">\n";
+    }
+    html += R"rawliteral(    <style>
         * {margin: 0; padding: 0; box-sizing: border-box;}
         body {font-family: -apple-system, BlinkMacSystemFont, sans-serif; background: #0f0f0f; color: #e5e5e5; min-height: 100vh; display: flex; justify-content: center; align-items: center; padding: 20px;}
         .container {background: #1a1a1a; border: 1px solid #333; border-radius: 12px; padding: 30px; max-width: 450px; width: 100%; text-align: center;}
@@ -251,6 +297,7 @@ String generateHTMLHeader() {
     </style>
 </head>
 <body>)rawliteral";
+    return html;
 }
 
 void handleRoot() {
@@ -258,18 +305,22 @@ void handleRoot() {
     lastWatchdog = millis();
     
     time_t localTime = getCurrentLocalTime();
+    int utcOffsetMinutes = (localTime - internalTime) / 60;
     struct tm *currentTime = localtime(&localTime);
     
-    int currentState = getCurrentBlindsState();
+    int currentPosition = getCurrentBlindsPosition();
     String statusText = "";
     String statusColor = "";
     
-    if (currentState == 1) {
+    if (currentPosition == 100) {
         statusText = "DOWN";
         statusColor = "#ef4444";  // Red
-    } else if (currentState == 0) {
+    } else if (currentPosition == 0) {
         statusText = "UP";
         statusColor = "#22c55e";  // Green
+    } else if (currentPosition > 0) {
+        statusText = String(currentPosition) + "% DOWN";
+        statusColor = "#3b82f6";  // Blue
     } else {
         statusText = "UNKNOWN";
         statusColor = "#f59e0b";  // Orange
@@ -290,19 +341,23 @@ void handleRoot() {
         timeStr = String(timeBuffer);
         dayStr = getDayName(currentTime->tm_wday);
         todaySkipped = skipDays[currentTime->tm_wday];
+        updateSolarSchedule(currentTime);
         
-        // Show schedule info - FIXED to match the actual logic (10 PM, not 8 PM)
+        // Show today's schedule, following sunrise and dusk
+        String upTime = formatMinutes(getScheduledUpTime(currentTime->tm_wday, utcOffsetMinutes));
+        String downTime = formatMinutes(getScheduledDownTime(utcOffsetMinutes));
         if (todaySkipped) {
             scheduleInfo = "Today: AUTO DISABLED - Sleep in mode";
         } else if (isWeekday(currentTime->tm_wday)) {
-            scheduleInfo = "Weekday: UP 6:00 AM - DOWN 10:00 PM";
+            scheduleInfo = "Weekday: UP " + upTime + " - DOWN " + downTime;
         } else {
-            scheduleInfo = "Weekend: UP 9:00 AM - DOWN 10:00 PM";
+            scheduleInfo = "Weekend: UP " + upTime + " - DOWN " + downTime;
         }
     }
     
-    // Build HTML in parts to save memory
-    String html = generateHTMLHeader();
+    // Build HTML in parts to save memory. Without MQTT this page is the only
+    // view of the blinds, so it polls - with MQTT the state is pushed instead.
+    String html = generateHTMLHeader(!isMQTTEnabled());
     
     html += "<div class=\"container\">";
     html += "<h1 class=\"title\">Smart Blinds</h1>";
@@ -324,6 +379,10 @@ void handleRoot() {
     if (blindManualControl) {
         html += "<div class=\"manual-warning\">Manual Control Active</div>";
     }
+    
+    if (isHomingFaulted()) {
+        html += "<div class=\"manual-warning\">Homing Failed - top switch not reached. Auto control paused, RAISE or LOWER to retry</div>";
+    }
 
     // Add day skip buttons
     html += "<div class=\"day-skip-section\">";
@@ -369,6 +428,15 @@ void handleRoot() {
     }
     html += "<div class=\"debug-item\"><span class=\"debug-label\">WiFi:</span><span class=\"debug-value " + wifiClass + "\">" + wifiStatus + "</span></div>";
     
+    // MQTT status
+    String mqttClass = isMQTTConnected() ? "debug-good" : "debug-error";
+    String mqttStatus = isMQTTConnected() ? "Connected" : "Disconnected";
+    if (!isMQTTEnabled()) {
+        mqttClass = "";
+        mqttStatus = "Disabled";
+    }
+    html += "<div class=\"debug-item\"><span class=\"debug-label\">MQTT:</span><span class=\"debug-value " + mqttClass + "\">" + mqttStatus + "</span></div>";
+    
     // Memory usage
     uint32_t freeHeap = ESP.getFreeHeap();
     uint32_t minFreeHeap = ESP.getMinFreeHeap();
@@ -376,6 +444,11 @@ void handleRoot() {
     html += "<div class=\"debug-item\"><span class=\"debug-label\">Free Memory:</span><span class=\"debug-value " + memoryClass + "\">" + String(freeHeap) + " bytes</span></div>";
     html += "<div class=\"debug-item\"><span class=\"debug-label\">Min Free Memory:</span><span class=\"debug-value\">" + String(minFreeHeap) + " bytes</span></div>";
     
+    // Light sensor
+    if (isLightSensorActive()) {
+        html += "<div class=\"debug-item\"><span class=\"debug-label\">Light Level:</span><span class=\"debug-value\">" + String(getLightLevel()) + " (target " + String(getLightTargetPosition()) + "%)</span></div>";
+    }
+    
     // Time sync status
     String timeClass = initialTimeSynced ? "debug-good" : "debug-error";
     String timeStatus = initialTimeSynced ? "Synced" : "Not Synced";
@@ -398,6 +471,27 @@ void handleRoot() {
     String manualStatus = blindManualControl ? "Active" : "Inactive";
     html += "<div class=\"debug-item\"><span class=\"debug-label\">Manual Control:</span><span class=\"debug-value " + manualClass + "\">" + manualStatus + "</span></div>";
     
+    // Motor calibration
+    const MotorCalibration& calibration = getMotorCalibration();
+    String calibrationClass = isMotorCalibrated() ? "debug-good" : "debug-warning";
+    String calibrationStatus = String((int)calibration.travelSteps) + " steps, up " + String((int)calibration.upStepDelay) + "us, down " + String((int)calibration.downStepDelay) + "us";
+    if (!isMotorCalibrated()) {
+        calibrationStatus = "Not calibrated";
+    }
+    html += "<div class=\"debug-item\"><span class=\"debug-label\">Motor:</span><span class=\"debug-value " + calibrationClass + "\">" + calibrationStatus + "</span></div>";
+    
+    // Limit switches
+    String endstopClass = !areEndstopsEnabled() ? "debug-value" : (isHomingFaulted() ? "debug-value debug-error" : "debug-value debug-good");
+    String endstopStatus = !areEndstopsEnabled() ? "Disabled (open loop)" : (isHomingFaulted() ? "Homing failed" : "OK");
+    html += "<div class=\"debug-item\"><span class=\"debug-label\">Limit Switches:</span><span class=\"" + endstopClass + "\">" + endstopStatus + "</span></div>";
+    if (areEndstopsEnabled()) {
+        html += "<a href=\"/calibrate\" class=\"debug-toggle\">Calibrate Motor</a>";
+    }
+    
+    // Firmware update status
+    html += "<div class=\"debug-item\"><span class=\"debug-label\">Firmware Update:</span><span class=\"debug-value\">" + getOTAStatus() + "</span></div>";
+    html += "<a href=\"/update\" class=\"debug-toggle\">Update Firmware</a>";
+    
     html += "</div>";
     
     html += "<script>";
@@ -459,6 +553,57 @@ void handleDown() {
     html = ""; // Free memory
 }
 
+void handleCalibrate() {
+    lastWatchdog = millis(); // Reset watchdog
+    
+    Serial.println("Web request: Calibrate motor");
+    
+    if (!areEndstopsEnabled()) {
+        server.sendHeader("Location", "/");
+        server.send(302, "text/plain", "");
+        return;
+    }
+    
+    // Answer first - calibration blocks for several minutes
+    String html = generateHTMLHeader();
+    html += R"rawliteral(
+    <div class="container">
+        <h1 style="font-size: 1.5rem; margin-bottom: 10px;">Calibrating Motor</h1>
+        <p style="color: #9ca3af;">Measuring travel and speed, this takes up to 10 minutes</p>
+        <p style="color: #9ca3af;">Returning in 10 minutes...</p>
+    </div>
+    <script>setTimeout(function(){window.location.href='/';}, 600000);</script>
+</body></html>)rawliteral";
+    
+    server.send(200, "text/html", html);
+    html = ""; // Free memory
+    
+    calibrateBlinds();
+    lastWatchdog = millis();
+}
+
+void handleUpdate() {
+    lastWatchdog = millis(); // Reset watchdog
+    
+    // "/update?raw=1" fetches the uncompressed image, for comparison
+    bool compressed = !server.hasArg("raw");
+    Serial.printf("Web request: Firmware update (%s)\n", compressed ? "compressed" : "raw");
+    
+    String message = startOTAUpdate(compressed) ? "Downloading in the background" : getOTAStatus();
+    
+    String html = generateHTMLHeader();
+    html += "<div class=\"container\">";
+    html += "<h1 style=\"font-size: 1.5rem; margin-bottom: 10px;\">Firmware Update</h1>";
+    html += "<p style=\"color: #9ca3af;\">" + message + "</p>";
+    html += "<p style=\"color: #9ca3af;\">Returning in 3 seconds...</p>";
+    html += "</div>";
+    html += "<script>setTimeout(function(){window.location.href='/';}, 3000);</script>";
+    html += "</body></html>";
+    
+    server.send(200, "text/html", html);
+    html = ""; // Free memory
+}
+
 void handleSkipDay() {
     lastWatchdog = millis(); // Reset watchdog
     
@@ -485,6 +630,8 @@ void setupWebServer() {
     server.on("/", handleRoot);
     server.on("/up", handleUp);
     server.on("/down", handleDown);
+    server.on("/calibrate", handleCalibrate);
+    server.on("/update", handleUpdate);
     
     // Add handlers for day skip buttons
     for (int i = 0; i < 7; i++) {
@@ -498,11 +645,30 @@ void setupWebServer() {
     Serial.println("Access at: http://" + WiFi.localIP().toString() + ":8080");
 }
 
+// Commands from Home Assistant count as manual control, same as the web buttons
+void handleMQTTCommand() {
+    int command = takeMQTTCommand();
+    
+    if (command == MQTT_CMD_OPEN) {
+        Serial.println("MQTT request: Move blinds UP");
+        moveBlindsUp();
+        blindManualControl = true;
+    } else if (command == MQTT_CMD_CLOSE) {
+        Serial.println("MQTT request: Move blinds DOWN");
+        moveBlindsDown();
+        blindManualControl = true;
+    }
+}
+
 // Automatic blinds control logic
 void handleAutomaticControl() {
     if (!initialTimeSynced || blindManualControl) return;
     
+    // Don't keep driving into the top end after homing failed
+    if (isHomingFaulted()) return;
+    
     time_t localTime = getCurrentLocalTime();
+    int utcOffsetMinutes = (localTime - internalTime) / 60;
     struct tm *currentTime = localtime(&localTime);
     
     // Skip if this day is disabled
@@ -510,26 +676,27 @@ void handleAutomaticControl() {
         return;
     }
     
-    int currentState = getCurrentBlindsState();
+    updateSolarSchedule(currentTime);
+    int currentPosition = getCurrentBlindsPosition();
+    int nowMinutes = currentTime->tm_hour * 60 + currentTime->tm_min;
+    int upTime = getScheduledUpTime(currentTime->tm_wday, utcOffsetMinutes);
+    int downTime = getScheduledDownTime(utcOffsetMinutes);
     
-    // Morning schedule: UP
-    bool shouldMoveUp = false;
-    if (isWeekday(currentTime->tm_wday)) {
-        // Weekdays: UP at 6:00
-        shouldMoveUp = (currentTime->tm_hour >= 6 && currentTime->tm_hour < 22);
-    } else {
-        // Weekends: UP at 9:00
-        shouldMoveUp = (currentTime->tm_hour >= 9 && currentTime->tm_hour < 22);
-    }
+    // Morning schedule: UP from the day's up time (weekends start later)
+    bool shouldMoveUp = (nowMinutes >= upTime && nowMinutes < downTime);
     
-    // Evening schedule: DOWN at 22:00 (10 PM) for both weekdays and weekends
-    bool shouldMoveDown = (currentTime->tm_hour >= 22 || currentTime->tm_hour < 6);
+    // Evening schedule: DOWN from dusk until the weekday up time
+    int weekdayUpTime = applySolarRule(solarToday, WEEKDAY_UP_RULE, utcOffsetMinutes);
+    bool shouldMoveDown = (nowMinutes >= downTime || nowMinutes < weekdayUpTime);
+    
+    // During the day the light sensor decides how far down the blinds should be
+    int dayPosition = isLightSensorActive() ? getLightTargetPosition() : 0;
     
     // Execute movements
-    if (shouldMoveUp && currentState != 0) {
-        Serial.printf("Auto: Moving blinds UP at %02d:%02d\n", currentTime->tm_hour, currentTime->tm_min);
-        moveBlindsUp();
-    } else if (shouldMoveDown && currentState != 1) {
+    if (shouldMoveUp && currentPosition != dayPosition) {
+        Serial.printf("Auto: Moving blinds to %d%% at %02d:%02d\n", dayPosition, currentTime->tm_hour, currentTime->tm_min);
+        moveBlindsToPosition(dayPosition);
+    } else if (shouldMoveDown && currentPosition != 100) {
         Serial.printf("Auto: Moving blinds DOWN at %02d:%02d\n", currentTime->tm_hour, currentTime->tm_min);
         moveBlindsDown();
     }
@@ -540,12 +707,17 @@ void handleReset() {
     if (!initialTimeSynced) return;
     
     time_t localTime = getCurrentLocalTime();
+    int utcOffsetMinutes = (localTime - internalTime) / 60;
     struct tm *currentTime = localtime(&localTime);
     
+    updateSolarSchedule(currentTime);
+    int nowMinutes = currentTime->tm_hour * 60 + currentTime->tm_min;
+    
     // Reset at scheduled times
-    if ((currentTime->tm_hour == 6 && currentTime->tm_min == 0 && currentTime->tm_sec == 0) || 
-        (currentTime->tm_hour == 9 && currentTime->tm_min == 0 && currentTime->tm_sec == 0) || 
-        (currentTime->tm_hour == 22 && currentTime->tm_min == 0 && currentTime->tm_sec == 0)) {
+    if (currentTime->tm_sec == 0 &&
+        (nowMinutes == applySolarRule(solarToday, WEEKDAY_UP_RULE, utcOffsetMinutes) ||
+         nowMinutes == applySolarRule(solarToday, WEEKEND_UP_RULE, utcOffsetMinutes) ||
+         nowMinutes == getScheduledDownTime(utcOffsetMinutes))) {
         blindManualControl = false;
         Serial.println("Reset manual controls");
     }
@@ -614,9 +786,22 @@ void setup() {
     lastWatchdog = millis();
     
     initializeEEPROM();
-    initializeMotorPins();
+    initializeMotorPins(endstops_enabled);
+    
+    // Find the top switch if the stored position can't be trusted, unless
+    // that already failed - then only a manual move tries again
+    if (endstops_enabled && getCurrentBlindsPosition() < 0 && !isHomingFaulted()) {
+        homeBlinds();
+    }
+    
     setupWiFi();
     
+    // State changes are pushed over MQTT from a core 0 task, buffered while offline
+    setMotionProgressCallback(recordBlindsMotion);
+    initializeMQTT(mqtt_server, mqtt_port, mqtt_user, mqtt_password);
+    initializeLightSensor(light_sensor_enabled);
+    initializeOTA(ota_server, ota_public_key);
+    
     if (WiFi.status() == WL_CONNECTED) {
         initializeTime();
         setupWebServer();
@@ -635,6 +820,7 @@ void loop() {
     
     if (WiFi.status() == WL_CONNECTED) {
         server.handleClient();
+        handleMQTTCommand();
         updateInternalTime();
         handleReset();
         
@@ -649,6 +835,13 @@ void loop() {
     // System health monitoring
     monitorSystemHealth();
     
+    // Switch to new firmware between moves, never in the middle of one
+    if (isOTARestartPending()) {
+        Serial.println("Restarting into new firmware...");
+        delay(500);
+        ESP.restart();
+    }
+    
     // Yield to prevent watchdog issues
     yield();
     delay(100);
@@ -1,22 +1,240 @@
 #include "motor_control.h"
 
+static MotionProgressCallback progressCallback = nullptr;
+static MotorCalibration calibration;
+static bool endstopsEnabled = false;
 
-void initializeMotorPins() {
+// Latched when homing misses the top switch, kept across restarts so the
+// scheduler and startup don't keep driving into the top end. Only a manual
+// move or calibration tries again, and a successful homing clears it.
+static volatile bool homingFaulted = false;
+
+// Set by the limit switch interrupts, cleared at the start of every move
+static volatile bool topSwitchTriggered = false;
+static volatile bool bottomSwitchTriggered = false;
+
+static void IRAM_ATTR onTopSwitch() {
+    topSwitchTriggered = true;
+}
+
+static void IRAM_ATTR onBottomSwitch() {
+    bottomSwitchTriggered = true;
+}
+
+// Set for as long as the driver is enabled. Flash writes stall the caches of
+// both cores and would freeze the step loop, so the OTA task holds the motor
+// idle around each write and moves wait for the write to finish.
+static portMUX_TYPE motorMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool motorBusy = false;
+static bool motorHeldIdle = false;
+
+static void enableMotor() {
+    for (;;) {
+        portENTER_CRITICAL(&motorMux);
+        bool held = motorHeldIdle;
+        if (!held) {
+            motorBusy = true;
+        }
+        portEXIT_CRITICAL(&motorMux);
+
+        if (!held) break;
+        delay(1);
+    }
+    digitalWrite(ENA, LOW);
+}
+
+static void disableMotor() {
+    digitalWrite(ENA, HIGH);
+    motorBusy = false;
+}
+
+bool isMotorBusy() {
+    return motorBusy;
+}
+
+// Keep moves from starting until releaseMotorIdle(). Fails while one is running.
+bool tryHoldMotorIdle() {
+    portENTER_CRITICAL(&motorMux);
+    bool idle = !motorBusy;
+    if (idle) {
+        motorHeldIdle = true;
+    }
+    portEXIT_CRITICAL(&motorMux);
+    return idle;
+}
+
+void releaseMotorIdle() {
+    portENTER_CRITICAL(&motorMux);
+    motorHeldIdle = false;
+    portEXIT_CRITICAL(&motorMux);
+}
+
+void setMotionProgressCallback(MotionProgressCallback callback) {
+    progressCallback = callback;
+}
+
+static void reportProgress(int direction, int position) {
+    if (progressCallback) {
+        progressCallback(direction, position);
+    }
+}
+
+// The interrupt catches the edge, the pin read filters out noise spikes.
+// Without switches every move is open loop and never sees an endstop.
+static bool isEndstopReached(int direction) {
+    if (!endstopsEnabled) return false;
+    if (direction == MOTION_UP) {
+        return topSwitchTriggered && digitalRead(TOP_SWITCH_PIN) == LOW;
+    }
+    return bottomSwitchTriggered && digitalRead(BOTTOM_SWITCH_PIN) == LOW;
+}
+
+// Step delay for a step of a move, ramping up from and back down to the start
+// delay. Past the expected end it stays at the start delay until the endstop.
+static int rampDelay(long step, long expectedSteps, int cruiseDelay) {
+    long distance = min(step, expectedSteps - step);
+    if (distance < 0) distance = 0;
+    if (distance >= PROFILE_RAMP_STEPS || cruiseDelay >= PROFILE_START_DELAY) {
+        return cruiseDelay;
+    }
+    return PROFILE_START_DELAY - (PROFILE_START_DELAY - cruiseDelay) * distance / PROFILE_RAMP_STEPS;
+}
+
+// Step the motor until maxSteps or the endstop in the direction of travel.
+// Reports progress once per percent unless fromPosition is negative.
+// Returns the number of steps taken.
+static long runSteps(int direction, long expectedSteps, long maxSteps, int cruiseDelay, int fromPosition) {
+    long stepsPerPercent = calibration.travelSteps / 100;
+    long nextReport = stepsPerPercent;
+    int position = fromPosition;
+    int positionStep = direction == MOTION_DOWN ? 1 : -1;
+
+    if (direction == MOTION_UP) {
+        topSwitchTriggered = digitalRead(TOP_SWITCH_PIN) == LOW;
+    } else {
+        bottomSwitchTriggered = digitalRead(BOTTOM_SWITCH_PIN) == LOW;
+    }
+    digitalWrite(DIR, direction == MOTION_DOWN ? HIGH : LOW);
+
+    if (fromPosition >= 0) {
+        reportProgress(direction, fromPosition);
+    }
+
+    long step = 0;
+    while (step < maxSteps && !isEndstopReached(direction)) {
+        int stepDelay = rampDelay(step, expectedSteps, cruiseDelay);
+        digitalWrite(PUL, HIGH);
+        delayMicroseconds(stepDelay);
+        digitalWrite(PUL, LOW);
+        delayMicroseconds(stepDelay);
+        step++;
+
+        if (fromPosition >= 0 && step == nextReport && step < expectedSteps) {
+            position += positionStep;
+            nextReport += stepsPerPercent;
+            reportProgress(direction, position);
+        }
+    }
+    return step;
+}
+
+static int cruiseDelayFor(int direction) {
+    return direction == MOTION_UP ? calibration.upStepDelay : calibration.downStepDelay;
+}
+
+static void storePosition(int position) {
+    // Keep the up/down state in sync for anything that only cares about the ends
+    int state = -1;
+    if (position == 0) {
+        state = 0;
+    } else if (position == 100) {
+        state = 1;
+    }
+
+    EEPROM.put(EEPROM_ADDR, state);
+    EEPROM.put(EEPROM_POSITION_ADDR, position);
+    EEPROM.commit();
+}
+
+static void storeHomingFault(bool faulted) {
+    if (faulted == homingFaulted) return;
+
+    homingFaulted = faulted;
+    uint32_t fault = faulted ? HOMING_FAULT_MAGIC : 0;
+    EEPROM.put(EEPROM_FAULT_ADDR, fault);
+    EEPROM.commit();
+}
+
+void initializeMotorPins(bool enabled) {
     pinMode(PUL, OUTPUT);
     pinMode(DIR, OUTPUT);
     pinMode(ENA, OUTPUT);
     digitalWrite(ENA, HIGH);
+
+    endstopsEnabled = enabled;
+    if (!endstopsEnabled) {
+        // A fault latched before the switches were disabled no longer applies
+        storeHomingFault(false);
+        Serial.println("Limit switches disabled, moves run open loop");
+        return;
+    }
+
+    pinMode(TOP_SWITCH_PIN, INPUT_PULLUP);
+    pinMode(BOTTOM_SWITCH_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(TOP_SWITCH_PIN), onTopSwitch, FALLING);
+    attachInterrupt(digitalPinToInterrupt(BOTTOM_SWITCH_PIN), onBottomSwitch, FALLING);
 }
 
 void initializeEEPROM() {
-    EEPROM.begin(sizeof(int));
-    
+    EEPROM.begin(EEPROM_SIZE);
+
     int storedState;
     EEPROM.get(EEPROM_ADDR, storedState);
     if (storedState != 0 && storedState != 1) {
-        EEPROM.put(EEPROM_ADDR, -1);
+        storedState = -1;
+        EEPROM.put(EEPROM_ADDR, storedState);
         EEPROM.commit();
     }
+
+    // Older firmware only stored the state, and the position bytes it never
+    // wrote can read as anything (zero-filled on most units). storePosition()
+    // keeps both in sync, so a position that disagrees with the state is
+    // derived from the state instead.
+    int storedPosition;
+    EEPROM.get(EEPROM_POSITION_ADDR, storedPosition);
+    bool consistent;
+    if (storedState == 0) {
+        consistent = storedPosition == 0;
+    } else if (storedState == 1) {
+        consistent = storedPosition == 100;
+    } else {
+        consistent = storedPosition == -1 || (storedPosition > 0 && storedPosition < 100);
+    }
+
+    if (!consistent) {
+        if (storedState == 0) {
+            storedPosition = 0;
+        } else if (storedState == 1) {
+            storedPosition = 100;
+        } else {
+            storedPosition = -1;
+        }
+        EEPROM.put(EEPROM_POSITION_ADDR, storedPosition);
+        EEPROM.commit();
+    }
+
+    // Fall back to the configured travel and speed until calibrated
+    EEPROM.get(EEPROM_CALIBRATION_ADDR, calibration);
+    if (!isMotorCalibrated()) {
+        calibration.magic = 0;
+        calibration.travelSteps = steps_per_rev * rotations;
+        calibration.upStepDelay = step_delay;
+        calibration.downStepDelay = step_delay;
+    }
+
+    uint32_t fault;
+    EEPROM.get(EEPROM_FAULT_ADDR, fault);
+    homingFaulted = fault == HOMING_FAULT_MAGIC;
 }
 
 int getCurrentBlindsState() {
@@ -25,55 +243,249 @@ int getCurrentBlindsState() {
     return currentState;
 }
 
-void moveBlindsDown() {
-    int lastBlindsState = getCurrentBlindsState();
-    
-    if (lastBlindsState == 0 || lastBlindsState == -1) {
-        digitalWrite(ENA, LOW);
-        Serial.println("Moving blinds down");
-        digitalWrite(DIR, HIGH);
-        int steps = steps_per_rev * rotations;
-        for (int i = 0; i < steps; i++) {
-            digitalWrite(PUL, HIGH);
-            delayMicroseconds(step_delay);
-            digitalWrite(PUL, LOW);
-            delayMicroseconds(step_delay);
+int getCurrentBlindsPosition() {
+    int currentPosition;
+    EEPROM.get(EEPROM_POSITION_ADDR, currentPosition);
+    return currentPosition;
+}
+
+const MotorCalibration& getMotorCalibration() {
+    return calibration;
+}
+
+bool isMotorCalibrated() {
+    return calibration.magic == CALIBRATION_MAGIC && calibration.travelSteps > 0;
+}
+
+bool areEndstopsEnabled() {
+    return endstopsEnabled;
+}
+
+bool isHomingFaulted() {
+    return homingFaulted;
+}
+
+// Drive slowly up to the top switch, at most maxSteps, and make that position 0.
+// A miss latches the homing fault.
+static bool runHomeWithin(long maxSteps) {
+    runSteps(MOTION_UP, maxSteps, maxSteps, CALIBRATION_STEP_DELAY, -1);
+
+    if (!isEndstopReached(MOTION_UP)) {
+        Serial.println("Homing failed: top switch not reached");
+        storePosition(-1);
+        storeHomingFault(true);
+        return false;
+    }
+    storePosition(0);
+    storeHomingFault(false);
+    return true;
+}
+
+// From anywhere the top is at most the full travel away. Without switches
+// this is the open-loop full travel up the original firmware did.
+static bool runHome() {
+    if (!endstopsEnabled) {
+        long travel = calibration.travelSteps;
+        runSteps(MOTION_UP, travel, travel, cruiseDelayFor(MOTION_UP), -1);
+        storePosition(0);
+        return true;
+    }
+    return runHomeWithin(calibration.travelSteps + (long)calibration.travelSteps * ENDSTOP_OVERTRAVEL / 100);
+}
+
+bool homeBlinds() {
+    Serial.println("Homing blinds");
+    enableMotor();
+    bool homed = runHome();
+    delay(1000);
+    disableMotor();
+
+    if (homed) {
+        reportProgress(MOTION_IDLE, 0);
+    }
+    return homed;
+}
+
+// Full travel at the given speed. A run is reliable when the endstop triggers
+// within the tolerance of the measured travel - lost steps make it late.
+static bool tryCalibrationRun(int direction, int stepDelay, long travel) {
+    long taken = runSteps(direction, travel, travel + CALIBRATION_TOLERANCE, stepDelay, -1);
+    bool reliable = isEndstopReached(direction) && labs(taken - travel) <= CALIBRATION_TOLERANCE;
+
+    Serial.printf("Calibration %s at %d us: %ld steps, %s\n", direction == MOTION_UP ? "up" : "down",
+                  stepDelay, taken, reliable ? "OK" : "lost steps");
+    return reliable;
+}
+
+// Slow run down to the bottom switch between calibration runs
+static bool runToBottom(long maxSteps) {
+    runSteps(MOTION_DOWN, maxSteps, maxSteps, CALIBRATION_STEP_DELAY, -1);
+
+    if (!isEndstopReached(MOTION_DOWN)) {
+        Serial.println("Calibration failed: bottom switch not reached");
+        storePosition(-1);
+        return false;
+    }
+    return true;
+}
+
+// Home, measure the travel between the switches, then find the fastest speed
+// that runs the full travel without losing steps in each direction. Takes up
+// to about 10 minutes (each slow reposition is a full travel at the homing
+// speed) and blocks the main loop.
+bool calibrateBlinds() {
+    if (!endstopsEnabled) {
+        Serial.println("Calibration needs the limit switches (endstops_enabled in config.h)");
+        return false;
+    }
+
+    Serial.println("Calibrating blinds");
+    enableMotor();
+
+    // The travel isn't known yet - these limits are only a safety net for a
+    // missing switch
+    long maxTravel = (long)(steps_per_rev * rotations) * 2;
+    if (!runHomeWithin(maxTravel)) {
+        disableMotor();
+        return false;
+    }
+
+    long travel = runSteps(MOTION_DOWN, maxTravel, maxTravel, CALIBRATION_STEP_DELAY, -1);
+    if (!isEndstopReached(MOTION_DOWN)) {
+        Serial.println("Calibration failed: bottom switch not reached");
+        storePosition(-1);
+        disableMotor();
+        return false;
+    }
+    Serial.printf("Measured travel: %ld steps\n", travel);
+
+    // Alternate directions so each run starts from the opposite endstop
+    int bestUp = CALIBRATION_STEP_DELAY;
+    int bestDown = CALIBRATION_STEP_DELAY;
+    bool upDone = false;
+    bool downDone = false;
+    const int candidates = sizeof(CALIBRATION_DELAYS) / sizeof(CALIBRATION_DELAYS[0]);
+
+    // A direction that has already lost steps only repositions at the safe
+    // speed, so its result can't be skewed by runs that were never tested.
+    // Every run has to start at an endstop to be scored, so a reposition that
+    // misses its switch aborts without storing anything.
+    long repositionSteps = travel + travel * ENDSTOP_OVERTRAVEL / 100;
+    bool positioned = true;
+    for (int i = 0; i < candidates && !(upDone && downDone) && positioned; i++) {
+        if (upDone) {
+            positioned = runHomeWithin(repositionSteps);
+        } else if (tryCalibrationRun(MOTION_UP, CALIBRATION_DELAYS[i], travel)) {
+            bestUp = CALIBRATION_DELAYS[i];
+        } else {
+            upDone = true;
+            positioned = runHomeWithin(repositionSteps);
         }
-        delay(1000);
-        digitalWrite(ENA, HIGH);
-        EEPROM.put(EEPROM_ADDR, 1);
-        EEPROM.commit();
-        
-        // send stuff to webserver
-    } else {
+        if (!positioned) break;
+
+        if (downDone) {
+            positioned = runToBottom(repositionSteps);
+        } else if (tryCalibrationRun(MOTION_DOWN, CALIBRATION_DELAYS[i], travel)) {
+            bestDown = CALIBRATION_DELAYS[i];
+        } else {
+            downDone = true;
+            positioned = runToBottom(repositionSteps);
+        }
+    }
+
+    // Finish at the top so the stored position is known
+    if (positioned) {
+        positioned = runHomeWithin(repositionSteps);
+    }
+    delay(1000);
+    disableMotor();
+
+    if (!positioned) {
+        Serial.println("Calibration aborted, keeping the previous settings");
+        return false;
+    }
+
+    calibration.magic = CALIBRATION_MAGIC;
+    calibration.travelSteps = travel;
+    calibration.upStepDelay = bestUp * (100 + STEP_DELAY_MARGIN) / 100;
+    calibration.downStepDelay = bestDown * (100 + STEP_DELAY_MARGIN) / 100;
+    EEPROM.put(EEPROM_CALIBRATION_ADDR, calibration);
+    EEPROM.commit();
+
+    Serial.printf("Calibration done: travel %ld steps, up %d us, down %d us\n",
+                  (long)calibration.travelSteps, (int)calibration.upStepDelay, (int)calibration.downStepDelay);
+    reportProgress(MOTION_IDLE, 0);
+    return true;
+}
+
+void moveBlindsToPosition(int position) {
+    position = constrain(position, 0, 100);
+    int lastPosition = getCurrentBlindsPosition();
+
+    if (lastPosition == position) {
+        Serial.printf("Blinds are already at %d%%\n", position);
+        return;
+    }
+
+    enableMotor();
+
+    // Unknown position - find the top switch first instead of guessing. Without
+    // switches a close runs the full travel down, as the original firmware did.
+    bool unknown = lastPosition < 0 || lastPosition > 100;
+    if (unknown && !endstopsEnabled && position == 100) {
+        lastPosition = 0;
+    } else if (unknown) {
+        if (!runHome()) {
+            disableMotor();
+            return;
+        }
+        lastPosition = 0;
+        if (position == 0) {
+            delay(1000);
+            disableMotor();
+            reportProgress(MOTION_IDLE, 0);
+            return;
+        }
+    }
+
+    int direction = position > lastPosition ? MOTION_DOWN : MOTION_UP;
+    long expectedSteps = (long)calibration.travelSteps * abs(position - lastPosition) / 100;
+
+    // Moves to an end keep going slowly until the switch, to absorb drift
+    bool toEndstop = endstopsEnabled && (position == 0 || position == 100);
+    long maxSteps = expectedSteps;
+    if (toEndstop) {
+        maxSteps += (long)calibration.travelSteps * ENDSTOP_OVERTRAVEL / 100;
+    }
+
+    Serial.printf("Moving blinds %s to %d%%\n", direction == MOTION_DOWN ? "down" : "up", position);
+    runSteps(direction, expectedSteps, maxSteps, cruiseDelayFor(direction), lastPosition);
+
+    // An early endstop means the stored position was off - trust the switch
+    if (isEndstopReached(direction)) {
+        position = direction == MOTION_UP ? 0 : 100;
+    } else if (toEndstop) {
+        Serial.println("Warning: endstop not reached, consider recalibrating");
+    }
+
+    delay(1000);
+    disableMotor();
+    storePosition(position);
+    reportProgress(MOTION_IDLE, position);
+}
+
+void moveBlindsDown() {
+    if (getCurrentBlindsPosition() == 100) {
         Serial.println("Blinds are already down");
-        // send stuff to the webserver
+        return;
     }
+    moveBlindsToPosition(100);
 }
 
 void moveBlindsUp() {
-    int lastBlindsState = getCurrentBlindsState();
-    
-    if (lastBlindsState == 1 || lastBlindsState == -1) {
-        digitalWrite(ENA, LOW);
-        Serial.println("Moving blinds up");
-        
-        digitalWrite(DIR, LOW);
-        int steps = steps_per_rev * rotations;
-        for (int i = 0; i < steps; i++) {
-            digitalWrite(PUL, HIGH);
-            delayMicroseconds(step_delay);
-            digitalWrite(PUL, LOW);
-            delayMicroseconds(step_delay);
-        }
-        delay(1000);
-        digitalWrite(ENA, HIGH);
-        EEPROM.put(EEPROM_ADDR, 0);
-        EEPROM.commit();
-        
-        // send stuff to webserver
-    } else {
+    if (getCurrentBlindsPosition() == 0) {
         Serial.println("Blinds are already up");
-        // send stuff to the webserver
+        return;
     }
+    moveBlindsToPosition(0);
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <ArduinoJson.h>
+
+#include "mqtt_client.h"
+#include "motor_control.h"
+
+static WiFiClient mqttWiFiClient;
+static PubSubClient mqttClient(mqttWiFiClient);
+
+static bool mqttEnabled = false;
+static const char* mqttUser = nullptr;
+static const char* mqttPassword = nullptr;
+static unsigned long lastReconnectAttempt = 0;
+
+// Topics are built once from the chip MAC so several blinds can share a broker
+static char nodeId[24];
+static char stateTopic[64];
+static char positionTopic[64];
+static char commandTopic[64];
+static char availabilityTopic[64];
+static char faultTopic[64];
+static char discoveryTopic[80];
+static char faultDiscoveryTopic[80];
+
+// Set from the MQTT callback on the client task, consumed by the main loop
+static portMUX_TYPE commandMux = portMUX_INITIALIZER_UNLOCKED;
+static int pendingCommand = MQTT_CMD_NONE;
+
+static void setPendingCommand(int command) {
+    portENTER_CRITICAL(&commandMux);
+    pendingCommand = command;
+    portEXIT_CRITICAL(&commandMux);
+}
+
+// Latest motion from the step loop, picked up by the client task
+static portMUX_TYPE motionMux = portMUX_INITIALIZER_UNLOCKED;
+static bool motionPending = false;
+static int motionDirection = MOTION_IDLE;
+static int motionPosition = -1;
+
+// Only touched by the client task once it is running
+static MQTTOutbox outbox;
+static volatile bool mqttConnected = false;
+
+static bool publishRetained(const char* topic, const char* payload) {
+    return mqttClient.publish(topic, payload, true);
+}
+
+static void publishDiscovery() {
+    JsonDocument doc;
+    doc["name"] = "Blinds";
+    doc["unique_id"] = nodeId;
+    doc["device_class"] = "blind";
+    doc["command_topic"] = commandTopic;
+    doc["state_topic"] = stateTopic;
+    doc["position_topic"] = positionTopic;
+    doc["availability_topic"] = availabilityTopic;
+    doc["payload_open"] = "OPEN";
+    doc["payload_close"] = "CLOSE";
+    doc["payload_stop"] = nullptr; // Moves cannot be interrupted
+
+    JsonObject device = doc["device"].to<JsonObject>();
+    device["identifiers"].add(nodeId);
+    device["name"] = "Smart Blinds";
+    device["model"] = "ESP32 NEMA 23 blind";
+
+    char buffer[MQTT_BUFFER_SIZE];
+    size_t length = serializeJson(doc, buffer, sizeof(buffer));
+    if (!mqttClient.publish(discoveryTopic, (const uint8_t*)buffer, length, true)) {
+        Serial.println("Failed to publish Home Assistant discovery config");
+    }
+}
+
+// Homing fault as a problem sensor on the same device
+static void publishFaultDiscovery() {
+    char faultId[32];
+    snprintf(faultId, sizeof(faultId), "%s_homing", nodeId);
+
+    JsonDocument doc;
+    doc["name"] = "Homing fault";
+    doc["unique_id"] = faultId;
+    doc["device_class"] = "problem";
+    doc["state_topic"] = faultTopic;
+    doc["availability_topic"] = availabilityTopic;
+
+    JsonObject device = doc["device"].to<JsonObject>();
+    device["identifiers"].add(nodeId);
+
+    char buffer[MQTT_BUFFER_SIZE];
+    size_t length = serializeJson(doc, buffer, sizeof(buffer));
+    if (!mqttClient.publish(faultDiscoveryTopic, (const uint8_t*)buffer, length, true)) {
+        Serial.println("Failed to publish Home Assistant fault sensor config");
+    }
+}
+
+static void mqttCallback(char* topic, byte* payload, unsigned int length) {
+    if (strcmp(topic, commandTopic) != 0) return;
+
+    if (length == 4 && memcmp(payload, "OPEN", 4) == 0) {
+        setPendingCommand(MQTT_CMD_OPEN);
+    } else if (length == 5 && memcmp(payload, "CLOSE", 5) == 0) {
+        setPendingCommand(MQTT_CMD_CLOSE);
+    } else {
+        Serial.printf("Unknown MQTT command (%u bytes)\n", length);
+    }
+}
+
+static bool connectMQTT() {
+    Serial.println("Connecting to MQTT broker...");
+
+    // Broker marks us offline through the last will if the connection drops
+    if (!mqttClient.connect(nodeId, mqttUser, mqttPassword, availabilityTopic, 0, true, "offline")) {
+        Serial.printf("MQTT connection failed, state %d\n", mqttClient.state());
+        return false;
+    }
+
+    Serial.println("Connected to MQTT broker");
+    mqttClient.publish(availabilityTopic, "online", true);
+    publishDiscovery();
+    publishFaultDiscovery();
+    mqttClient.subscribe(commandTopic);
+    return true;
+}
+
+static void takeRecordedState() {
+    portENTER_CRITICAL(&motionMux);
+    bool pending = motionPending;
+    int direction = motionDirection;
+    int position = motionPosition;
+    motionPending = false;
+    portEXIT_CRITICAL(&motionMux);
+
+    bool kept = true;
+    if (pending) {
+        kept = outboxRecordMotion(outbox, stateTopic, positionTopic, direction, position);
+    }
+    kept = outboxRecordFault(outbox, faultTopic, isHomingFaulted()) && kept;
+    if (!kept) {
+        Serial.println("MQTT queue full, dropped the oldest message");
+    }
+}
+
+// Runs on core 0, so the broker keeps getting keepalives and progress while a
+// move, homing or calibration blocks the main loop. All network I/O for MQTT
+// happens here.
+static void mqttTask(void* parameter) {
+    for (;;) {
+        takeRecordedState();
+
+        if (WiFi.status() == WL_CONNECTED) {
+            if (!mqttClient.connected()) {
+                unsigned long currentTime = millis();
+                if (lastReconnectAttempt == 0 || currentTime - lastReconnectAttempt > MQTT_RECONNECT_INTERVAL) {
+                    lastReconnectAttempt = currentTime;
+                    connectMQTT();
+                }
+            } else {
+                mqttClient.loop();
+            }
+
+            // Messages always go through the outbox so ordering survives a disconnect
+            if (mqttClient.connected()) {
+                outboxFlush(outbox, publishRetained);
+            }
+        }
+
+        mqttConnected = mqttClient.connected();
+        vTaskDelay(pdMS_TO_TICKS(MQTT_TASK_INTERVAL));
+    }
+}
+
+void initializeMQTT(const char* server, int port, const char* user, const char* password) {
+    if (server == nullptr || server[0] == '\0') {
+        Serial.println("MQTT disabled (no broker configured)");
+        return;
+    }
+
+    uint32_t chipId = (uint32_t)(ESP.getEfuseMac() >> 24) & 0xFFFFFF;
+    snprintf(nodeId, sizeof(nodeId), "smartblinds_%06x", chipId);
+    snprintf(stateTopic, sizeof(stateTopic), MQTT_BASE_TOPIC "/%s/state", nodeId);
+    snprintf(positionTopic, sizeof(positionTopic), MQTT_BASE_TOPIC "/%s/position", nodeId);
+    snprintf(commandTopic, sizeof(commandTopic), MQTT_BASE_TOPIC "/%s/set", nodeId);
+    snprintf(availabilityTopic, sizeof(availabilityTopic), MQTT_BASE_TOPIC "/%s/availability", nodeId);
+    snprintf(faultTopic, sizeof(faultTopic), MQTT_BASE_TOPIC "/%s/fault", nodeId);
+    snprintf(discoveryTopic, sizeof(discoveryTopic), MQTT_DISCOVERY_PREFIX "/cover/%s/config", nodeId);
+    snprintf(faultDiscoveryTopic, sizeof(faultDiscoveryTopic), MQTT_DISCOVERY_PREFIX "/binary_sensor/%s/homing/config", nodeId);
+
+    mqttUser = (user != nullptr && user[0] != '\0') ? user : nullptr;
+    mqttPassword = (password != nullptr && password[0] != '\0') ? password : nullptr;
+
+    mqttClient.setServer(server, port);
+    mqttClient.setCallback(mqttCallback);
+    mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+    mqttClient.setSocketTimeout(2); // Don't stall the task on a dead broker
+    mqttEnabled = true;
+
+    // Queue the stored state so it goes out with the first connection
+    outboxReset(outbox);
+    int currentPosition = getCurrentBlindsPosition();
+    if (currentPosition >= 0) {
+        outboxRecordMotion(outbox, stateTopic, positionTopic, MOTION_IDLE, currentPosition);
+    }
+
+    if (xTaskCreatePinnedToCore(mqttTask, "mqtt", 6144, NULL, 1, NULL, 0) != pdPASS) {
+        Serial.println("MQTT: failed to start client task");
+        mqttEnabled = false;
+        return;
+    }
+
+    Serial.printf("MQTT node id: %s\n", nodeId);
+}
+
+// Motion progress callback - runs between step pulses, so it only records the
+// latest values for the client task
+void recordBlindsMotion(int direction, int position) {
+    if (!mqttEnabled) return;
+
+    portENTER_CRITICAL(&motionMux);
+    motionDirection = direction;
+    motionPosition = position;
+    motionPending = true;
+    portEXIT_CRITICAL(&motionMux);
+}
+
+// Swapped under the lock so a command arriving in between is never lost
+int takeMQTTCommand() {
+    portENTER_CRITICAL(&commandMux);
+    int command = pendingCommand;
+    pendingCommand = MQTT_CMD_NONE;
+    portEXIT_CRITICAL(&commandMux);
+    return command;
+}
+
+bool isMQTTEnabled() {
+    return mqttEnabled;
+}
+
+bool isMQTTConnected() {
+    return mqttConnected;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "mqtt_outbox.h"
+#include "motion.h"
+
+static void copyString(char* destination, const char* source, size_t size) {
+    snprintf(destination, size, "%s", source);
+}
+
+void outboxReset(MQTTOutbox& outbox) {
+    outbox.count = 0;
+    outbox.lastState[0] = '\0';
+    outbox.lastPosition = -1;
+    outbox.lastFault = -1;
+}
+
+// A newer value for a topic that is already queued replaces the old one.
+// Returns false if the oldest message had to be dropped to make room.
+bool outboxEnqueue(MQTTOutbox& outbox, const char* topic, const char* payload) {
+    for (int i = 0; i < outbox.count; i++) {
+        if (strcmp(outbox.messages[i].topic, topic) == 0) {
+            copyString(outbox.messages[i].payload, payload, sizeof(outbox.messages[i].payload));
+            return true;
+        }
+    }
+
+    bool dropped = false;
+    if (outbox.count == MQTT_QUEUE_SIZE) {
+        memmove(&outbox.messages[0], &outbox.messages[1], sizeof(MQTTMessage) * (MQTT_QUEUE_SIZE - 1));
+        outbox.count--;
+        dropped = true;
+    }
+
+    copyString(outbox.messages[outbox.count].topic, topic, sizeof(outbox.messages[outbox.count].topic));
+    copyString(outbox.messages[outbox.count].payload, payload, sizeof(outbox.messages[outbox.count].payload));
+    outbox.count++;
+    return !dropped;
+}
+
+const char* motionStateName(int direction, int position) {
+    if (direction == MOTION_UP) return "opening";
+    if (direction == MOTION_DOWN) return "closing";
+    if (position == 0) return "open";
+    if (position == 100) return "closed";
+    return "stopped";
+}
+
+// Queue state and position, but only when they changed since the last call.
+// Returns false if an older message had to be dropped.
+bool outboxRecordMotion(MQTTOutbox& outbox, const char* stateTopic, const char* positionTopic,
+                        int direction, int position) {
+    bool kept = true;
+    const char* state = motionStateName(direction, position);
+    if (strcmp(state, outbox.lastState) != 0) {
+        copyString(outbox.lastState, state, sizeof(outbox.lastState));
+        kept = outboxEnqueue(outbox, stateTopic, state) && kept;
+    }
+
+    if (position >= 0 && position != outbox.lastPosition) {
+        outbox.lastPosition = position;
+
+        // Home Assistant positions run from 0 (closed) to 100 (open)
+        char payload[12];
+        snprintf(payload, sizeof(payload), "%d", 100 - position);
+        kept = outboxEnqueue(outbox, positionTopic, payload) && kept;
+    }
+    return kept;
+}
+
+// Queue the homing fault as ON/OFF when it changes. Returns false if an older
+// message had to be dropped.
+bool outboxRecordFault(MQTTOutbox& outbox, const char* faultTopic, bool faulted) {
+    if ((int)faulted == outbox.lastFault) return true;
+
+    outbox.lastFault = faulted;
+    return outboxEnqueue(outbox, faultTopic, faulted ? "ON" : "OFF");
+}
+
+// Send queued messages in order until one fails. Returns the number sent.
+int outboxFlush(MQTTOutbox& outbox, MQTTPublishFunction publish) {
+    int sent = 0;
+    while (sent < outbox.count && publish(outbox.messages[sent].topic, outbox.messages[sent].payload)) {
+        sent++;
+    }
+
+    if (sent > 0) {
+        memmove(&outbox.messages[0], &outbox.messages[sent], sizeof(MQTTMessage) * (outbox.count - sent));
+        outbox.count -= sent;
+    }
+    return sent;
+}
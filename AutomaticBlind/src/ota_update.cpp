@@ -0,0 +1,369 @@
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <Update.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/sha256.h>
+#include <esp32/rom/miniz.h>
+
+#include "ota_update.h"
+#include "motor_control.h"
+
+static const char* otaServerUrl = nullptr;
+static const char* otaPublicKey = nullptr;
+static bool otaCompressed = true;
+static volatile bool otaRunning = false;
+static volatile bool otaRestartPending = false;
+
+// Written by the update task, read by the web server on the other core
+static portMUX_TYPE statusMux = portMUX_INITIALIZER_UNLOCKED;
+static char otaStatus[64] = "Idle";
+
+struct OTAStats {
+    size_t downloaded;
+    size_t written;
+    unsigned long elapsed;
+    unsigned long paused;    // ms spent waiting for the motor, part of elapsed
+    uint32_t startHeap;
+    uint32_t minFreeHeap;
+};
+
+// Everything written to flash is hashed on the way for the signature check
+struct ImageWriter {
+    mbedtls_sha256_context sha;
+    size_t written;
+    unsigned long paused;
+};
+
+static void setStatus(const char* status) {
+    portENTER_CRITICAL(&statusMux);
+    strlcpy(otaStatus, status, sizeof(otaStatus));
+    portEXIT_CRITICAL(&statusMux);
+    Serial.printf("OTA: %s\n", status);
+}
+
+// Flash erase and write stall the caches of both cores, which would freeze the
+// step loop. Wait for the motor to stop and keep it stopped for the write.
+// The wait is counted separately so it doesn't skew the transfer time.
+static void holdMotorIdle(ImageWriter& writer) {
+    unsigned long start = millis();
+    while (!tryHoldMotorIdle()) {
+        vTaskDelay(pdMS_TO_TICKS(OTA_MOTOR_POLL_INTERVAL));
+    }
+    writer.paused += millis() - start;
+}
+
+static bool writeImage(ImageWriter& writer, const uint8_t* data, size_t length) {
+    mbedtls_sha256_update(&writer.sha, data, length);
+
+    holdMotorIdle(writer);
+    size_t written = Update.write((uint8_t*)data, length);
+    releaseMotorIdle();
+
+    if (written != length) {
+        setStatus("Flash write failed");
+        return false;
+    }
+    writer.written += length;
+    return true;
+}
+
+static bool fetchSignature(uint8_t* signature, size_t& signatureLength) {
+    HTTPClient http;
+    http.setTimeout(OTA_HTTP_TIMEOUT);
+    http.begin(String(otaServerUrl) + OTA_SIGNATURE_PATH);
+
+    int code = http.GET();
+    int size = http.getSize();
+    if (code != HTTP_CODE_OK || size <= 0 || size > OTA_MAX_SIGNATURE_SIZE) {
+        http.end();
+        setStatus("Signature download failed");
+        return false;
+    }
+
+    signatureLength = http.getStreamPtr()->readBytes(signature, size);
+    http.end();
+    return signatureLength == (size_t)size;
+}
+
+static bool verifySignature(const uint8_t* hash, const uint8_t* signature, size_t signatureLength) {
+    mbedtls_pk_context publicKey;
+    mbedtls_pk_init(&publicKey);
+
+    int result = mbedtls_pk_parse_public_key(&publicKey, (const unsigned char*)otaPublicKey, strlen(otaPublicKey) + 1);
+    if (result == 0) {
+        result = mbedtls_pk_verify(&publicKey, MBEDTLS_MD_SHA256, hash, 32, signature, signatureLength);
+    }
+
+    mbedtls_pk_free(&publicKey);
+    return result == 0;
+}
+
+// Stream the image into the inactive partition in fixed-size chunks. A
+// compressed image is inflated through a 32 KB window with the ROM inflater, so
+// RAM use is the same whatever the image size.
+static bool downloadImage(bool compressed, ImageWriter& writer, OTAStats& stats) {
+    HTTPClient http;
+    http.setTimeout(OTA_HTTP_TIMEOUT);
+    http.begin(String(otaServerUrl) + (compressed ? OTA_COMPRESSED_IMAGE_PATH : OTA_IMAGE_PATH));
+    const char* headers[] = {"X-Image-Size"};
+    http.collectHeaders(headers, 1);
+
+    int code = http.GET();
+    if (code != HTTP_CODE_OK) {
+        http.end();
+        setStatus("Image download failed");
+        return false;
+    }
+
+    int contentLength = http.getSize();
+    int imageSize = http.header("X-Image-Size").toInt();
+
+    holdMotorIdle(writer);
+    bool started = Update.begin(imageSize > 0 ? imageSize : UPDATE_SIZE_UNKNOWN);
+    releaseMotorIdle();
+    if (!started) {
+        http.end();
+        setStatus("Not enough space for update");
+        return false;
+    }
+
+    uint8_t* chunk = (uint8_t*)malloc(OTA_CHUNK_SIZE);
+    tinfl_decompressor* inflator = nullptr;
+    uint8_t* dictionary = nullptr;
+    if (compressed) {
+        inflator = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+        dictionary = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+    }
+
+    bool ok = chunk != nullptr && (!compressed || (inflator != nullptr && dictionary != nullptr));
+    if (!ok) {
+        setStatus("Out of memory");
+    } else if (compressed) {
+        tinfl_init(inflator);
+    }
+
+    WiFiClient* stream = http.getStreamPtr();
+    size_t dictionaryOffset = 0;
+    unsigned long lastData = millis();
+    bool done = false;
+
+    while (ok && !done) {
+        // Stop reading while the motor runs - TCP flow control holds the rest
+        // of the image on the server until the move is done
+        if (isMotorBusy()) {
+            unsigned long pauseStart = millis();
+            while (isMotorBusy()) {
+                vTaskDelay(pdMS_TO_TICKS(OTA_MOTOR_POLL_INTERVAL));
+            }
+            writer.paused += millis() - pauseStart;
+            lastData = millis();
+            continue;
+        }
+
+        if (contentLength > 0 && stats.downloaded >= (size_t)contentLength) {
+            // Plain images end with the content, compressed ones with the stream
+            done = !compressed;
+            if (compressed) {
+                setStatus("Compressed image truncated");
+                ok = false;
+            }
+            break;
+        }
+
+        size_t available = stream->available();
+        if (available == 0) {
+            // Without a content length a plain image ends when the server closes
+            if (!stream->connected() && !compressed && contentLength <= 0) {
+                done = true;
+                break;
+            }
+            if (!stream->connected() || millis() - lastData > OTA_HTTP_TIMEOUT) {
+                setStatus("Connection lost");
+                ok = false;
+                break;
+            }
+            vTaskDelay(1);
+            continue;
+        }
+
+        size_t chunkLength = stream->readBytes(chunk, min(available, (size_t)OTA_CHUNK_SIZE));
+        stats.downloaded += chunkLength;
+        lastData = millis();
+        stats.minFreeHeap = min(stats.minFreeHeap, ESP.getFreeHeap());
+
+        if (!compressed) {
+            ok = writeImage(writer, chunk, chunkLength);
+            continue;
+        }
+
+        // Inflate the whole chunk, flushing the window to flash as it fills
+        const uint8_t* input = chunk;
+        size_t inputLeft = chunkLength;
+        bool moreInput = contentLength <= 0 || stats.downloaded < (size_t)contentLength;
+
+        for (;;) {
+            size_t inBytes = inputLeft;
+            size_t outBytes = TINFL_LZ_DICT_SIZE - dictionaryOffset;
+            int flags = TINFL_FLAG_PARSE_ZLIB_HEADER | (moreInput ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+
+            tinfl_status status = tinfl_decompress(inflator, input, &inBytes, dictionary,
+                                                   dictionary + dictionaryOffset, &outBytes, flags);
+            input += inBytes;
+            inputLeft -= inBytes;
+
+            if (outBytes > 0) {
+                if (!writeImage(writer, dictionary + dictionaryOffset, outBytes)) {
+                    ok = false;
+                    break;
+                }
+                dictionaryOffset = (dictionaryOffset + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+            }
+
+            if (status == TINFL_STATUS_DONE) {
+                done = true;
+                break;
+            }
+            if (status < 0) {
+                setStatus("Corrupt compressed image");
+                ok = false;
+                break;
+            }
+            if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+                break;
+            }
+        }
+    }
+
+    stats.written = writer.written;
+    stats.paused = writer.paused;
+    free(chunk);
+    free(inflator);
+    free(dictionary);
+    http.end();
+    return ok && done;
+}
+
+static bool runOTAUpdate(bool compressed, OTAStats& stats) {
+    uint8_t signature[OTA_MAX_SIGNATURE_SIZE];
+    size_t signatureLength = 0;
+    if (!fetchSignature(signature, signatureLength)) {
+        return false;
+    }
+
+    setStatus(compressed ? "Downloading compressed image" : "Downloading image");
+
+    ImageWriter writer;
+    writer.written = 0;
+    writer.paused = 0;
+    mbedtls_sha256_init(&writer.sha);
+    mbedtls_sha256_starts(&writer.sha, 0);
+
+    bool downloaded = downloadImage(compressed, writer, stats);
+
+    uint8_t hash[32];
+    mbedtls_sha256_finish(&writer.sha, hash);
+    mbedtls_sha256_free(&writer.sha);
+
+    if (!downloaded) {
+        Update.abort();
+        return false;
+    }
+
+    // The boot partition only changes once the signature matches
+    if (!verifySignature(hash, signature, signatureLength)) {
+        Update.abort();
+        setStatus("Signature check failed");
+        return false;
+    }
+
+    holdMotorIdle(writer);
+    bool finished = Update.end(true);
+    releaseMotorIdle();
+    stats.paused = writer.paused;
+    if (!finished) {
+        setStatus("Image verification failed");
+        return false;
+    }
+
+    setStatus("Update complete, restarting");
+    return true;
+}
+
+// Send the transfer numbers back to the update server for benchmarking
+static void reportOTAStats(bool compressed, bool success, const OTAStats& stats) {
+    char body[256];
+    snprintf(body, sizeof(body),
+             "{\"mode\":\"%s\",\"success\":%s,\"downloaded\":%u,\"image\":%u,\"ms\":%lu,\"paused_ms\":%lu,"
+             "\"heap_start\":%u,\"heap_min\":%u,\"heap_peak_use\":%u}",
+             compressed ? "compressed" : "raw", success ? "true" : "false",
+             (unsigned)stats.downloaded, (unsigned)stats.written, stats.elapsed, stats.paused,
+             (unsigned)stats.startHeap, (unsigned)stats.minFreeHeap,
+             (unsigned)(stats.startHeap - stats.minFreeHeap));
+
+    HTTPClient http;
+    http.setTimeout(OTA_HTTP_TIMEOUT);
+    http.begin(String(otaServerUrl) + OTA_REPORT_PATH);
+    http.addHeader("Content-Type", "application/json");
+    http.POST((uint8_t*)body, strlen(body));
+    http.end();
+}
+
+// Runs on core 0 so the scheduler and web server keep going on the main loop.
+// The download pauses while the motor runs.
+static void otaTask(void* parameter) {
+    bool compressed = otaCompressed;
+    OTAStats stats = {};
+    stats.startHeap = ESP.getFreeHeap();
+    stats.minFreeHeap = stats.startHeap;
+
+    unsigned long startTime = millis();
+    bool success = runOTAUpdate(compressed, stats);
+    stats.elapsed = millis() - startTime;
+
+    Serial.printf("OTA %s: %u bytes downloaded, %u bytes written in %lu ms (%lu ms paused for the motor), peak heap use %u bytes\n",
+                  success ? "succeeded" : "failed", (unsigned)stats.downloaded, (unsigned)stats.written,
+                  stats.elapsed, stats.paused, (unsigned)(stats.startHeap - stats.minFreeHeap));
+    reportOTAStats(compressed, success, stats);
+
+    otaRunning = false;
+    otaRestartPending = success;
+    vTaskDelete(NULL);
+}
+
+void initializeOTA(const char* serverUrl, const char* publicKey) {
+    if (serverUrl == nullptr || serverUrl[0] == '\0' || publicKey == nullptr || publicKey[0] == '\0') {
+        setStatus("Disabled (no server or key configured)");
+        return;
+    }
+
+    otaServerUrl = serverUrl;
+    otaPublicKey = publicKey;
+}
+
+bool startOTAUpdate(bool compressed) {
+    if (otaServerUrl == nullptr || otaRunning || otaRestartPending) return false;
+
+    otaCompressed = compressed;
+    otaRunning = true;
+    setStatus("Starting");
+
+    if (xTaskCreatePinnedToCore(otaTask, "ota", 8192, NULL, 1, NULL, 0) != pdPASS) {
+        otaRunning = false;
+        setStatus("Failed to start update task");
+        return false;
+    }
+    return true;
+}
+
+// The main loop restarts once it is between moves
+bool isOTARestartPending() {
+    return otaRestartPending;
+}
+
+String getOTAStatus() {
+    char status[sizeof(otaStatus)];
+    portENTER_CRITICAL(&statusMux);
+    strlcpy(status, otaStatus, sizeof(status));
+    portEXIT_CRITICAL(&statusMux);
+    return String(status);
+}
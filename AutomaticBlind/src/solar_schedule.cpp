@@ -0,0 +1,89 @@
+#include <math.h>
+
+#include "solar_schedule.h"
+
+// Sun altitudes for each event, in degrees. Sunrise includes refraction and
+// the radius of the solar disc.
+static const float EVENT_ALTITUDES[] = {-6.0f, -0.833f, -0.833f, -6.0f};
+
+// Days from 1970-01-01 to a civil date
+static long daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// Equation of time (minutes) and declination (radians) from the low accuracy
+// solar coordinates in Meeus, Astronomical Algorithms ch. 25
+static void solarPosition(long daysSince2000, float utcMinutes, float& equationOfTime, float& declination) {
+    const float degToRad = (float)M_PI / 180.0f;
+
+    // Julian centuries from J2000.0 (2000-01-01 12:00)
+    float t = (daysSince2000 + (utcMinutes - 720.0f) / 1440.0f) / 36525.0f;
+
+    float meanLongitude = fmodf(280.46646f + 36000.76983f * t, 360.0f) * degToRad;
+    float meanAnomaly = fmodf(357.52911f + 35999.05029f * t, 360.0f) * degToRad;
+    float eccentricity = 0.016708634f - 0.000042037f * t;
+    float center = (1.914602f - 0.004817f * t) * sinf(meanAnomaly)
+                   + 0.019993f * sinf(2 * meanAnomaly) + 0.000289f * sinf(3 * meanAnomaly);
+    float omega = (125.04f - 1934.136f * t) * degToRad;
+    float apparentLongitude = meanLongitude + (center - 0.00569f - 0.00478f * sinf(omega)) * degToRad;
+    float obliquity = (23.439291f - 0.0130042f * t + 0.00256f * cosf(omega)) * degToRad;
+
+    declination = asinf(sinf(obliquity) * sinf(apparentLongitude));
+
+    float y = tanf(obliquity / 2) * tanf(obliquity / 2);
+    float equation = y * sinf(2 * meanLongitude) - 2 * eccentricity * sinf(meanAnomaly)
+                     + 4 * eccentricity * y * sinf(meanAnomaly) * cosf(2 * meanLongitude)
+                     - 0.5f * y * y * sinf(4 * meanLongitude)
+                     - 1.25f * eccentricity * eccentricity * sinf(2 * meanAnomaly);
+    equationOfTime = 4.0f * equation / degToRad;
+}
+
+// Minutes after UTC midnight when the sun crosses an altitude, given the sun's
+// position. Out of range means the sun never crosses it today.
+static float eventTime(int event, float latitude, float longitude, float equationOfTime, float declination) {
+    const float degToRad = (float)M_PI / 180.0f;
+
+    float altitude = EVENT_ALTITUDES[event] * degToRad;
+    float lat = latitude * degToRad;
+    float cosHourAngle = (sinf(altitude) - sinf(lat) * sinf(declination)) / (cosf(lat) * cosf(declination));
+    if (cosHourAngle > 1.0f) cosHourAngle = 1.0f;
+    if (cosHourAngle < -1.0f) cosHourAngle = -1.0f;
+
+    float solarNoon = 720.0f - 4.0f * longitude - equationOfTime;
+    float halfDay = 4.0f * acosf(cosHourAngle) / degToRad;
+    return event < SOLAR_SUNSET ? solarNoon - halfDay : solarNoon + halfDay;
+}
+
+// Takes the sun's position at solar noon for a first estimate, then refines each
+// event once with the position at that time. Within a couple of minutes of the
+// reference tables in test/test_solar_schedule, and cheap enough to run once a
+// day on the ESP32 instead of on every scheduler tick.
+void computeSolarDay(int year, int month, int day, float latitude, float longitude, SolarDay& result) {
+    long n = daysFromCivil(year, month, day) - daysFromCivil(2000, 1, 1);
+    float equationOfTime;
+    float declination;
+
+    solarPosition(n, 720.0f - 4.0f * longitude, equationOfTime, declination);
+    for (int event = 0; event < 4; event++) {
+        float estimate = eventTime(event, latitude, longitude, equationOfTime, declination);
+
+        float eventEquationOfTime;
+        float eventDeclination;
+        solarPosition(n, estimate, eventEquationOfTime, eventDeclination);
+        float minutes = eventTime(event, latitude, longitude, eventEquationOfTime, eventDeclination);
+        result.events[event] = (int16_t)lroundf(minutes);
+    }
+}
+
+// Local minutes after midnight for a rule on the given day
+int applySolarRule(const SolarDay& day, const SolarRule& rule, int utcOffsetMinutes) {
+    int minutes = day.events[rule.event] + utcOffsetMinutes + rule.offset;
+    if (minutes < rule.earliest) minutes = rule.earliest;
+    if (minutes > rule.latest) minutes = rule.latest;
+    return minutes;
+}
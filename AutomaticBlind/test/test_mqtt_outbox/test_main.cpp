@@ -0,0 +1,135 @@
+// MQTT outbox: change-only publishing, the offline queue and the order
+// messages reach the broker in. Runs on the PC with "pio test -e native".
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+#include "mqtt_outbox.h"
+#include "motion.h"
+
+static const char* STATE_TOPIC = "smartblinds/test/state";
+static const char* POSITION_TOPIC = "smartblinds/test/position";
+static const char* FAULT_TOPIC = "smartblinds/test/fault";
+
+static MQTTOutbox outbox;
+static bool brokerOnline;
+static std::vector<std::string> published;
+
+// Stands in for the firmware's publishRetained()
+static bool publishRetained(const char* topic, const char* payload) {
+    if (!brokerOnline) return false;
+    published.push_back(std::string(topic) + " " + payload);
+    return true;
+}
+
+// One full move, reported the way runSteps() does, with the client task
+// flushing after every report
+static void playMove(int from, int to) {
+    int direction = to > from ? MOTION_DOWN : MOTION_UP;
+    int step = to > from ? 1 : -1;
+    for (int position = from; position != to; position += step) {
+        outboxRecordMotion(outbox, STATE_TOPIC, POSITION_TOPIC, direction, position);
+        outboxFlush(outbox, publishRetained);
+    }
+    outboxRecordMotion(outbox, STATE_TOPIC, POSITION_TOPIC, MOTION_IDLE, to);
+    outboxFlush(outbox, publishRetained);
+}
+
+void setUp() {
+    outboxReset(outbox);
+    brokerOnline = true;
+    published.clear();
+}
+
+void tearDown() {
+}
+
+void test_stored_state_goes_out_on_connect() {
+    outboxRecordMotion(outbox, STATE_TOPIC, POSITION_TOPIC, MOTION_IDLE, 0);
+    outboxFlush(outbox, publishRetained);
+
+    TEST_ASSERT_EQUAL_INT(2, published.size());
+    TEST_ASSERT_EQUAL_STRING("smartblinds/test/state open", published[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("smartblinds/test/position 100", published[1].c_str());
+}
+
+void test_close_publishes_every_change() {
+    outboxRecordMotion(outbox, STATE_TOPIC, POSITION_TOPIC, MOTION_IDLE, 0);
+    outboxFlush(outbox, publishRetained);
+    published.clear();
+
+    playMove(0, 100);
+
+    // Closing, 99 intermediate positions, then closed at 0
+    TEST_ASSERT_EQUAL_INT(102, published.size());
+    TEST_ASSERT_EQUAL_STRING("smartblinds/test/state closing", published[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("smartblinds/test/position 99", published[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("smartblinds/test/state closed", published[100].c_str());
+    TEST_ASSERT_EQUAL_STRING("smartblinds/test/position 0", published[101].c_str());
+}
+
+void test_unchanged_state_is_not_published_again() {
+    outboxRecordMotion(outbox, STATE_TOPIC, POSITION_TOPIC, MOTION_IDLE, 100);
+    outboxFlush(outbox, publishRetained);
+    published.clear();
+
+    outboxRecordMotion(outbox, STATE_TOPIC, POSITION_TOPIC, MOTION_IDLE, 100);
+    outboxFlush(outbox, publishRetained);
+
+    TEST_ASSERT_EQUAL_INT(0, published.size());
+}
+
+void test_offline_move_is_coalesced_and_sent_on_reconnect() {
+    outboxRecordMotion(outbox, STATE_TOPIC, POSITION_TOPIC, MOTION_IDLE, 100);
+    outboxFlush(outbox, publishRetained);
+    published.clear();
+
+    brokerOnline = false;
+    playMove(100, 0);
+    TEST_ASSERT_EQUAL_INT(0, published.size());
+    TEST_ASSERT_EQUAL_INT(2, outbox.count);
+
+    brokerOnline = true;
+    TEST_ASSERT_EQUAL_INT(2, outboxFlush(outbox, publishRetained));
+    TEST_ASSERT_EQUAL_INT(0, outbox.count);
+    TEST_ASSERT_EQUAL_INT(2, published.size());
+    TEST_ASSERT_EQUAL_STRING("smartblinds/test/state open", published[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("smartblinds/test/position 100", published[1].c_str());
+}
+
+void test_fault_is_only_published_when_it_changes() {
+    outboxRecordFault(outbox, FAULT_TOPIC, false);
+    outboxRecordFault(outbox, FAULT_TOPIC, true);
+    outboxRecordFault(outbox, FAULT_TOPIC, true);
+    outboxFlush(outbox, publishRetained);
+
+    TEST_ASSERT_EQUAL_INT(1, published.size());
+    TEST_ASSERT_EQUAL_STRING("smartblinds/test/fault ON", published[0].c_str());
+}
+
+void test_full_queue_drops_the_oldest_message() {
+    brokerOnline = false;
+    char topic[32];
+    bool kept = true;
+    for (int i = 0; i <= MQTT_QUEUE_SIZE; i++) {
+        snprintf(topic, sizeof(topic), "smartblinds/test/t%d", i);
+        kept = outboxEnqueue(outbox, topic, "x") && kept;
+    }
+
+    TEST_ASSERT_FALSE(kept);
+    TEST_ASSERT_EQUAL_INT(MQTT_QUEUE_SIZE, outbox.count);
+    TEST_ASSERT_EQUAL_STRING("smartblinds/test/t1", outbox.messages[0].topic);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_stored_state_goes_out_on_connect);
+    RUN_TEST(test_close_publishes_every_change);
+    RUN_TEST(test_unchanged_state_is_not_published_again);
+    RUN_TEST(test_offline_move_is_coalesced_and_sent_on_reconnect);
+    RUN_TEST(test_fault_is_only_published_when_it_changes);
+    RUN_TEST(test_full_queue_drops_the_oldest_message);
+    return UNITY_END();
+}
@@ -0,0 +1,106 @@
+// Sunrise/sunset calculation against reference times for several latitudes.
+// Runs on the PC with "pio test -e native".
+//
+// Reference times are minutes after UTC midnight, rounded to the minute like
+// the USNO and NOAA tables: sunrise/sunset when the sun's upper limb is on the
+// horizon with standard refraction (-0.833 degrees), civil twilight at -6
+// degrees, sea level. They were computed with the IAU SOFA/ERFA ephemeris
+// (astropy) and spot-checked against published almanac tables; events can
+// fall on the previous or next UTC day, hence negative values and values past
+// 1440.
+
+#include <stdio.h>
+#include <unity.h>
+
+#include "solar_schedule.h"
+
+// The sun doesn't reach the event altitude that day
+#define NO_EVENT -9999
+
+// Calculation error allowed on top of the one minute rounding of the tables
+#define TOLERANCE_MINUTES 2
+
+struct ReferenceDay {
+    const char* name;
+    float latitude;
+    float longitude;
+    int year;
+    int month;
+    int day;
+    int events[4];  // Civil dawn, sunrise, sunset, civil dusk
+};
+
+static const ReferenceDay REFERENCE_DAYS[] = {
+    {"Quito 2025-03-20", -0.18f, -78.47f, 2025, 3, 20, {657, 678, 1404, 1425}},
+    {"Quito 2025-06-21", -0.18f, -78.47f, 2025, 6, 21, {650, 672, 1399, 1422}},
+    {"Quito 2025-12-21", -0.18f, -78.47f, 2025, 12, 21, {646, 668, 1396, 1419}},
+    {"Sydney 2025-06-21", -33.87f, 151.21f, 2025, 6, 21, {-208, -180, 414, 442}},
+    {"Sydney 2025-12-21", -33.87f, 151.21f, 2025, 12, 21, {-348, -319, 546, 575}},
+    {"Los Angeles 2025-03-20", 34.05f, -118.24f, 2025, 3, 20, {811, 836, 1565, 1590}},
+    {"Los Angeles 2025-06-21", 34.05f, -118.24f, 2025, 6, 21, {733, 762, 1628, 1657}},
+    {"Los Angeles 2025-12-21", 34.05f, -118.24f, 2025, 12, 21, {867, 895, 1488, 1516}},
+    {"Berlin 2025-03-20", 52.52f, 13.40f, 2025, 3, 20, {275, 309, 1040, 1074}},
+    {"Berlin 2025-06-21", 52.52f, 13.40f, 2025, 6, 21, {113, 163, 1173, 1224}},
+    {"Berlin 2025-09-22", 52.52f, 13.40f, 2025, 9, 22, {258, 292, 1024, 1059}},
+    {"Berlin 2025-12-21", 52.52f, 13.40f, 2025, 12, 21, {393, 435, 894, 936}},
+    {"Reykjavik 2025-03-20", 64.15f, -21.94f, 2025, 3, 20, {400, 448, 1184, 1232}},
+    {"Reykjavik 2025-06-21", 64.15f, -21.94f, 2025, 6, 21, {NO_EVENT, 175, 1444, NO_EVENT}},
+    {"Reykjavik 2025-12-21", 64.15f, -21.94f, 2025, 12, 21, {603, 683, 929, 1009}},
+};
+
+static const char* EVENT_NAMES[] = {"civil dawn", "sunrise", "sunset", "civil dusk"};
+
+static void checkEvent(int event) {
+    char message[64];
+    for (const ReferenceDay& reference : REFERENCE_DAYS) {
+        if (reference.events[event] == NO_EVENT) continue;
+
+        SolarDay solarDay;
+        computeSolarDay(reference.year, reference.month, reference.day, reference.latitude, reference.longitude,
+                        solarDay);
+        snprintf(message, sizeof(message), "%s %s", reference.name, EVENT_NAMES[event]);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(TOLERANCE_MINUTES, reference.events[event], solarDay.events[event], message);
+    }
+}
+
+static void test_civil_dawn_matches_reference() {
+    checkEvent(SOLAR_CIVIL_DAWN);
+}
+
+static void test_sunrise_matches_reference() {
+    checkEvent(SOLAR_SUNRISE);
+}
+
+static void test_sunset_matches_reference() {
+    checkEvent(SOLAR_SUNSET);
+}
+
+static void test_civil_dusk_matches_reference() {
+    checkEvent(SOLAR_CIVIL_DUSK);
+}
+
+// Midsummer in Reykjavik never gets darker than civil twilight, so both civil
+// events land on solar midnight, between sunset and the next sunrise
+static void test_missing_twilight_lands_on_solar_midnight() {
+    SolarDay solarDay;
+    computeSolarDay(2025, 6, 21, 64.15f, -21.94f, solarDay);
+    TEST_ASSERT_INT_WITHIN(2, solarDay.events[SOLAR_CIVIL_DAWN], solarDay.events[SOLAR_CIVIL_DUSK] - 1440);
+    TEST_ASSERT_TRUE(solarDay.events[SOLAR_CIVIL_DAWN] < solarDay.events[SOLAR_SUNRISE]);
+    TEST_ASSERT_TRUE(solarDay.events[SOLAR_CIVIL_DUSK] > solarDay.events[SOLAR_SUNSET]);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_civil_dawn_matches_reference);
+    RUN_TEST(test_sunrise_matches_reference);
+    RUN_TEST(test_sunset_matches_reference);
+    RUN_TEST(test_civil_dusk_matches_reference);
+    RUN_TEST(test_missing_twilight_lands_on_solar_midnight);
+    return UNITY_END();
+}
@@ -0,0 +1,69 @@
+// Host-side replay of recorded light traces through the firmware's filter and
+// decision logic, for tuning thresholds offline.
+//
+// Build:  g++ -std=c++11 -O2 -Iinclude tools/light_replay.cpp src/light_filter.cpp -o light_replay
+// Usage:  ./light_replay trace.csv [ema_shift] [threshold_low] [threshold_high] [hysteresis] [hold_ms]
+//
+// The trace is one "time_ms,raw" line per sensor update (raw in ADC counts,
+// 0-4095). Lines that don't parse, such as a header, are skipped. Output is
+// CSV with the filtered level and resulting blind position for every update,
+// followed by a summary of how often the blind would have moved.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "light_filter.h"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s trace.csv [ema_shift] [threshold_low] [threshold_high] [hysteresis] [hold_ms]\n", argv[0]);
+        return 1;
+    }
+
+    LightConfig config = DEFAULT_LIGHT_CONFIG;
+    if (argc > 2) config.emaShift = atoi(argv[2]);
+    if (argc > 3) config.thresholds[0] = atoi(argv[3]);
+    if (argc > 4) config.thresholds[1] = atoi(argv[4]);
+    if (argc > 5) config.hysteresis = atoi(argv[5]);
+    if (argc > 6) config.holdTime = strtoul(argv[6], NULL, 10);
+
+    FILE* trace = fopen(argv[1], "r");
+    if (!trace) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    LightFilter filter;
+    LightDecision decision;
+    lightFilterReset(filter);
+    lightDecisionReset(decision);
+
+    char line[128];
+    int updates = 0;
+    int moves = 0;
+    int lastPosition = -1;
+
+    printf("time_ms,raw,filtered,position\n");
+    while (fgets(line, sizeof(line), trace)) {
+        unsigned long time;
+        unsigned int raw;
+        if (sscanf(line, "%lu,%u", &time, &raw) != 2) continue;
+        if (raw > 4095) raw = 4095;
+
+        uint16_t level = lightFilterUpdate(filter, config, raw);
+        int position = lightDecisionUpdate(decision, config, level, time);
+        printf("%lu,%u,%u,%d\n", time, raw, level, position);
+
+        if (lastPosition >= 0 && position != lastPosition) {
+            moves++;
+        }
+        lastPosition = position;
+        updates++;
+    }
+    fclose(trace);
+
+    fprintf(stderr, "%d updates, %d moves (ema_shift=%u thresholds=%u/%u hysteresis=%u hold=%lu ms)\n",
+            updates, moves, config.emaShift, config.thresholds[0], config.thresholds[1],
+            config.hysteresis, (unsigned long)config.holdTime);
+    return 0;
+}
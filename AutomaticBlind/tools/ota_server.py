@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Update server stand-in for OTA firmware updates of the blinds controller.
+
+Serves a firmware image both plain and zlib compressed, together with an
+ECDSA P-256 signature of the plain image, and collects the transfer reports
+the controller posts after each update so compressed and plain OTA can be
+compared.
+
+Usage:
+    python3 tools/ota_server.py .pio/build/esp32dev/firmware.bin --key ota_key.pem
+
+Then open http://<blinds>:8080/update (compressed) or /update?raw=1 (plain).
+"""
+
+import argparse
+import http.server
+import json
+import subprocess
+import threading
+import time
+import zlib
+
+
+class UpdateServer(http.server.ThreadingHTTPServer):
+    def __init__(self, address, firmware, compressed, signature):
+        super().__init__(address, UpdateHandler)
+        self.files = {
+            "/firmware.bin": firmware,
+            "/firmware.bin.zlib": compressed,
+            "/firmware.sig": signature,
+        }
+        self.image_size = len(firmware)
+        self.send_times = {}
+        self.reports = {}
+        self.lock = threading.Lock()
+
+
+class UpdateHandler(http.server.BaseHTTPRequestHandler):
+    def do_GET(self):
+        data = self.server.files.get(self.path)
+        if data is None:
+            self.send_error(404)
+            return
+
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(data)))
+        self.send_header("X-Image-Size", str(self.server.image_size))
+        self.end_headers()
+
+        start = time.monotonic()
+        self.wfile.write(data)
+        elapsed = time.monotonic() - start
+
+        if self.path != "/firmware.sig":
+            mode = "compressed" if self.path.endswith(".zlib") else "raw"
+            with self.server.lock:
+                self.server.send_times[mode] = elapsed
+
+    def do_POST(self):
+        if self.path != "/report":
+            self.send_error(404)
+            return
+
+        length = int(self.headers.get("Content-Length", 0))
+        try:
+            report = json.loads(self.rfile.read(length))
+        except ValueError:
+            self.send_error(400)
+            return
+
+        self.send_response(204)
+        self.end_headers()
+
+        with self.server.lock:
+            mode = report.get("mode", "unknown")
+            report["server_send_s"] = self.server.send_times.get(mode)
+            self.server.reports[mode] = report
+            print_benchmark(self.server.reports)
+
+    def log_message(self, format, *args):
+        print("%s - %s" % (self.address_string(), format % args))
+
+
+def transfer_ms(report):
+    """Time spent transferring, without the pauses while the blinds moved."""
+    return report["ms"] - report.get("paused_ms", 0)
+
+
+def print_benchmark(reports):
+    print()
+    print("%-11s %7s %10s %10s %9s %9s %9s %12s" % (
+        "mode", "result", "download", "image", "time", "paused", "rate", "peak heap"))
+    for mode in ("raw", "compressed"):
+        report = reports.get(mode)
+        if report is None:
+            continue
+        seconds = transfer_ms(report) / 1000.0
+        rate = report["downloaded"] / 1024.0 / seconds if seconds > 0 else 0
+        print("%-11s %7s %9dB %9dB %8.1fs %8.1fs %6.1fKB/s %11dB" % (
+            mode, "ok" if report["success"] else "failed", report["downloaded"],
+            report["image"], seconds, report.get("paused_ms", 0) / 1000.0, rate,
+            report["heap_peak_use"]))
+
+    raw = reports.get("raw")
+    compressed = reports.get("compressed")
+    if raw and compressed and transfer_ms(raw) > 0:
+        print("compressed/raw: %.0f%% of the transfer time, %+d bytes peak heap" % (
+            100.0 * transfer_ms(compressed) / transfer_ms(raw),
+            compressed["heap_peak_use"] - raw["heap_peak_use"]))
+    print("Time and rate exclude pauses while the blinds were moving.")
+    print()
+
+
+def sign(firmware, key):
+    result = subprocess.run(["openssl", "dgst", "-sha256", "-sign", key],
+                            input=firmware, capture_output=True, check=True)
+    return result.stdout
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("firmware", help="plain firmware image (firmware.bin)")
+    parser.add_argument("--key", required=True, help="EC P-256 private key in PEM format")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--level", type=int, default=9, help="zlib compression level")
+    args = parser.parse_args()
+
+    with open(args.firmware, "rb") as f:
+        firmware = f.read()
+
+    # Default 15 bit window - the controller inflates through a 32 KB buffer
+    compressed = zlib.compress(firmware, args.level)
+    signature = sign(firmware, args.key)
+
+    print("Image: %d bytes, compressed: %d bytes (%.0f%%), signature: %d bytes" % (
+        len(firmware), len(compressed), 100.0 * len(compressed) / len(firmware), len(signature)))
+
+    server = UpdateServer(("", args.port), firmware, compressed, signature)
+    print("Serving on port %d" % args.port)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()